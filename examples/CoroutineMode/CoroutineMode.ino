@@ -0,0 +1,92 @@
+/*
+ * SPDX-FileCopyrightText: 2025 M5Stack Technology CO LTD
+ *
+ * SPDX-License-Identifier: MIT
+ */
+/* Requires a C++20 toolchain with coroutine support (e.g. arduino-esp32 3.x) */
+#include <Arduino.h>
+#include <M5Unified.h>
+#include <M5ModuleQRCode.h>
+
+M5ModuleQRCode module_qrcode;
+QRCodeExecutor executor;
+QRCodeAsync scanner(module_qrcode, executor);
+
+static bool is_busy = false;
+
+/* Start decode, wait up to 2 s for a code, stop decode, written as straight-line code */
+QRCodeTask scanOnce()
+{
+    char code[256];
+
+    is_busy = true;
+    M5.Display.setTextColor(TFT_WHITE);
+    M5.Display.println(">> Start scanning...");
+
+    co_await scanner.startDecode();
+    size_t len = co_await scanner.nextScan(code, sizeof(code), 2000);
+    co_await scanner.stopDecode();
+
+    if (len > 0) {
+        M5.Display.setTextColor(TFT_WHITE);
+        M5.Display.println(">> Get code:");
+        M5.Display.setTextColor(TFT_YELLOW);
+        M5.Display.println(code);
+    } else {
+        M5.Display.setTextColor(TFT_RED);
+        M5.Display.println(">> No code");
+    }
+    is_busy = false;
+}
+
+void setup()
+{
+    M5.begin();
+    M5.Display.setFont(&fonts::efontCN_16);
+    M5.Display.setTextScroll(true);
+
+    /* Set module config */
+    auto cfg     = module_qrcode.getConfig();
+    cfg.pin_tx   = 17;
+    cfg.pin_rx   = 16;
+    cfg.baudrate = 115200;
+    cfg.serial   = &Serial1;
+    module_qrcode.setConfig(cfg);
+
+    /* Init module */
+    while (!module_qrcode.begin()) {
+        M5.Display.setTextColor(TFT_RED);
+        M5.Display.println(">> Init module failed, retry...");
+        delay(1000);
+    }
+    M5.Display.setTextColor(TFT_WHITE);
+    M5.Display.println(">> Init module success");
+
+    /* Set light mode */
+    M5.Display.println(">> Set lights mode");
+    module_qrcode.setFillLightMode(QRCodeM14::FILL_LIGHT_ON_DECODE);
+    module_qrcode.setPosLightMode(QRCodeM14::POS_LIGHT_ON_DECODE);
+
+    /* Set trigger mode */
+    M5.Display.println(">> Set trigger mode to continuous");
+    module_qrcode.setTriggerMode(QRCodeM14::TRIGGER_MODE_CONTINUOUS);
+    module_qrcode.stopDecode();
+
+    M5.Display.println(">> Click BtnA to scan once");
+}
+
+void loop()
+{
+    M5.update();
+
+    /* If BtnA was clicked */
+    if (M5.BtnA.wasClicked() && !is_busy) {
+        scanOnce();
+    }
+
+    /* Resume coroutines that are ready */
+    executor.poll();
+
+    /* Print driver log records */
+    QRCodeM14::drainLog();
+}
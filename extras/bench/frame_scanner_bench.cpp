@@ -0,0 +1,80 @@
+/*
+ * SPDX-FileCopyrightText: 2025 M5Stack Technology CO LTD
+ *
+ * SPDX-License-Identifier: MIT
+ */
+/*
+ * Host throughput benchmark for QRCodeFrameScanner. Compares the word-at-a-time search with a byte loop on scan-like
+ * payloads of several sizes, with the response header at the end. Build notes in extras/README.md.
+ */
+#include "qrcode_frame.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+static const uint8_t* _byte_find_any(const uint8_t* data, size_t len, uint8_t a, uint8_t b)
+{
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] == a || data[i] == b) {
+            return data + i;
+        }
+    }
+    return nullptr;
+}
+
+// Prevents the compiler from dropping the searches
+static volatile uintptr_t _sink;
+
+template <typename Func>
+static double _measure_mb_s(size_t bytes_per_run, Func func)
+{
+    using Clock = std::chrono::steady_clock;
+
+    size_t runs = 1;
+    while (true) {
+        auto start = Clock::now();
+        for (size_t i = 0; i < runs; i++) {
+            func();
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        if (seconds > 0.2) {
+            return (double)bytes_per_run * runs / seconds / 1e6;
+        }
+        runs *= 2;
+    }
+}
+
+int main()
+{
+    const uint8_t cmd[]  = {0x43, 0x02, 0xC1};
+    const size_t sizes[] = {64, 1024, 4096, 65536};
+
+    printf("%8s %14s %14s %14s\n", "bytes", "byte MB/s", "findAny MB/s", "response MB/s");
+
+    for (size_t size : sizes) {
+        // Printable scan data, which never contains the opcodes, followed by a complete response
+        std::vector<uint8_t> data(size);
+        srand(1);
+        for (size_t i = 0; i < size; i++) {
+            data[i] = 'a' + rand() % 26;
+        }
+        const uint8_t response[] = {0x44, 0x02, 0xC1, 0x00, 0x01, '1'};
+        memcpy(data.data() + size - sizeof(response), response, sizeof(response));
+
+        double byte_rate = _measure_mb_s(size, [&]() {
+            _sink = (uintptr_t)_byte_find_any(data.data(), data.size(), cmd[0], cmd[0] + 1);
+        });
+        double word_rate = _measure_mb_s(size, [&]() {
+            _sink = (uintptr_t)QRCodeFrameScanner::findAny(data.data(), data.size(), cmd[0], cmd[0] + 1);
+        });
+        double frame_rate = _measure_mb_s(size, [&]() {
+            QRCodeFrameScanner::Frame_t frame;
+            _sink = QRCodeFrameScanner::findResponse(data.data(), data.size(), cmd, 0xFFFF, frame);
+        });
+
+        printf("%8zu %14.1f %14.1f %14.1f\n", size, byte_rate, word_rate, frame_rate);
+    }
+
+    return 0;
+}
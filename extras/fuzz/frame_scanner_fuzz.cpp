@@ -0,0 +1,138 @@
+/*
+ * SPDX-FileCopyrightText: 2025 M5Stack Technology CO LTD
+ *
+ * SPDX-License-Identifier: MIT
+ */
+/*
+ * libFuzzer target for QRCodeFrameScanner. Checks findResponse() and findAny() on arbitrary rx data against plain
+ * byte loop references, and that every reported frame lies inside the input. Build notes in extras/README.md.
+ *
+ * Input layout: cmd[0], cmd[1], cmd[2], max_payload_hi, max_payload_lo, rx data...
+ */
+#include "qrcode_frame.h"
+#include <stdlib.h>
+
+#define FUZZ_CHECK(cond) \
+    do {                 \
+        if (!(cond)) {   \
+            abort();     \
+        }                \
+    } while (0)
+
+static const uint8_t* _ref_find_any(const uint8_t* data, size_t len, uint8_t a, uint8_t b)
+{
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] == a || data[i] == b) {
+            return data + i;
+        }
+    }
+    return nullptr;
+}
+
+static QRCodeFrameScanner::Status_t _ref_find_response(const uint8_t* data, size_t len, const uint8_t* cmd,
+                                                       size_t max_payload, QRCodeFrameScanner::Frame_t& frame)
+{
+    for (size_t offset = 0; offset < len; offset++) {
+        const uint8_t* header = data + offset;
+        size_t remain         = len - offset;
+        if (header[0] != cmd[0] && header[0] != (uint8_t)(cmd[0] + 1)) {
+            continue;
+        }
+        if (remain < QRCodeFrameScanner::HEADER_SIZE) {
+            if ((remain < 2 || header[1] == cmd[1]) && (remain < 3 || header[2] == cmd[2])) {
+                frame.offset      = offset;
+                frame.payload_len = 0;
+                frame.payload     = nullptr;
+                return QRCodeFrameScanner::FRAME_PARTIAL;
+            }
+            continue;
+        }
+        if (header[1] != cmd[1] || header[2] != cmd[2]) {
+            continue;
+        }
+        size_t payload_len = ((size_t)header[3] << 8) | header[4];
+        if (payload_len == 0 || payload_len > max_payload) {
+            continue;
+        }
+        frame.offset      = offset;
+        frame.payload_len = payload_len;
+        if (remain < QRCodeFrameScanner::HEADER_SIZE + payload_len) {
+            frame.payload = nullptr;
+            return QRCodeFrameScanner::FRAME_PARTIAL;
+        }
+        frame.payload = header + QRCodeFrameScanner::HEADER_SIZE;
+        return QRCodeFrameScanner::FRAME_FOUND;
+    }
+    return QRCodeFrameScanner::FRAME_NOT_FOUND;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* input, size_t size)
+{
+    if (size < 5) {
+        return 0;
+    }
+
+    const uint8_t* cmd  = input;
+    size_t max_payload  = ((size_t)input[3] << 8) | input[4];
+    const uint8_t* data = input + 5;
+    size_t len          = size - 5;
+
+    // Word-at-a-time search must match the byte loop at every alignment
+    for (size_t skip = 0; skip < 4 && skip <= len; skip++) {
+        FUZZ_CHECK(QRCodeFrameScanner::findAny(data + skip, len - skip, cmd[0], cmd[1]) ==
+                   _ref_find_any(data + skip, len - skip, cmd[0], cmd[1]));
+    }
+
+    QRCodeFrameScanner::Frame_t frame;
+    QRCodeFrameScanner::Frame_t ref_frame;
+    auto status     = QRCodeFrameScanner::findResponse(data, len, cmd, max_payload, frame);
+    auto ref_status = _ref_find_response(data, len, cmd, max_payload, ref_frame);
+
+    FUZZ_CHECK(status == ref_status);
+    if (status == QRCodeFrameScanner::FRAME_NOT_FOUND) {
+        return 0;
+    }
+
+    FUZZ_CHECK(frame.offset == ref_frame.offset);
+    FUZZ_CHECK(frame.payload_len == ref_frame.payload_len);
+    FUZZ_CHECK(frame.offset < len);
+    if (status == QRCodeFrameScanner::FRAME_FOUND) {
+        FUZZ_CHECK(frame.payload == data + frame.offset + QRCodeFrameScanner::HEADER_SIZE);
+        FUZZ_CHECK(frame.payload_len > 0 && frame.payload_len <= max_payload);
+        FUZZ_CHECK(frame.payload + frame.payload_len <= data + len);
+    } else {
+        FUZZ_CHECK(frame.payload == nullptr);
+    }
+
+    return 0;
+}
+
+#ifdef FRAME_SCANNER_FUZZ_MAIN
+// Standalone driver for compilers without libFuzzer: random inputs biased towards valid headers
+#include <stdio.h>
+
+int main(int argc, char** argv)
+{
+    unsigned long iterations = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+    uint8_t input[512];
+
+    srand(1);
+    for (unsigned long i = 0; i < iterations; i++) {
+        size_t size = rand() % sizeof(input);
+        for (size_t j = 0; j < size; j++) {
+            input[j] = rand();
+        }
+        // Plant a few headers for the command, some of them damaged
+        for (int k = rand() % 4; k > 0 && size > 10; k--) {
+            size_t at     = 5 + rand() % (size - 5);
+            uint8_t hdr[] = {(uint8_t)(input[0] + rand() % 2), input[1], input[2], 0, (uint8_t)(rand() % 64)};
+            size_t n      = min(sizeof(hdr) - rand() % 2, size - at);
+            memcpy(input + at, hdr, n);
+        }
+        LLVMFuzzerTestOneInput(input, size);
+    }
+
+    printf("%lu inputs ok\n", iterations);
+    return 0;
+}
+#endif
@@ -0,0 +1,14 @@
+/*
+ * SPDX-FileCopyrightText: 2025 M5Stack Technology CO LTD
+ *
+ * SPDX-License-Identifier: MIT
+ */
+// Minimal Arduino.h for building the host-only parts of the library (see extras/README.md)
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <algorithm>
+
+using std::max;
+using std::min;
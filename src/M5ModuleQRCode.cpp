@@ -5,16 +5,14 @@
  */
 #include "M5ModuleQRCode.h"
 #include "debug.h"
+#include <new>
 
 #define CHANNEL_QRCODE_POWER_EN 0
 #define CHANNEL_QRCODE_TRIG     4
 
 M5ModuleQRCode::~M5ModuleQRCode()
 {
-    if (_pi4ioe5v6408 != nullptr) {
-        delete _pi4ioe5v6408;
-        _pi4ioe5v6408 = nullptr;
-    }
+    _release_pi4ioe5v6408();
 }
 
 bool M5ModuleQRCode::begin()
@@ -33,6 +31,20 @@ bool M5ModuleQRCode::begin()
     return true;
 }
 
+void M5ModuleQRCode::_release_pi4ioe5v6408()
+{
+    if (_pi4ioe5v6408 == nullptr) {
+        return;
+    }
+
+#if MODULE_QRCODE_STATIC_ALLOC
+    _pi4ioe5v6408->~PI4IOE5V6408_Class();
+#else
+    delete _pi4ioe5v6408;
+#endif
+    _pi4ioe5v6408 = nullptr;
+}
+
 bool M5ModuleQRCode::_init_pi4ioe5v6408()
 {
     _LOG_DEBUG("init pi4ioe5v6408\n");
@@ -42,12 +54,13 @@ bool M5ModuleQRCode::_init_pi4ioe5v6408()
     }
 
     // Probe device
-    if (_pi4ioe5v6408 != nullptr) {
-        delete _pi4ioe5v6408;
-        _pi4ioe5v6408 = nullptr;
-    }
+    _release_pi4ioe5v6408();
 
+#if MODULE_QRCODE_STATIC_ALLOC
+    _pi4ioe5v6408 = new (_pi4ioe5v6408_storage) m5::PI4IOE5V6408_Class(_config.pi4ioe5v6408_addr, 100000, _config.i2c);
+#else
     _pi4ioe5v6408 = new m5::PI4IOE5V6408_Class(_config.pi4ioe5v6408_addr, 100000, _config.i2c);
+#endif
 
     if (_pi4ioe5v6408 == nullptr) {
         _LOG_ERROR("pi4ioe5v6408 malloc failed\n");
@@ -56,8 +69,7 @@ bool M5ModuleQRCode::_init_pi4ioe5v6408()
 
     if (!_pi4ioe5v6408->begin()) {
         _LOG_ERROR("pi4ioe5v6408 not found at 0x%02x\n", _config.pi4ioe5v6408_addr);
-        delete _pi4ioe5v6408;
-        _pi4ioe5v6408 = nullptr;
+        _release_pi4ioe5v6408();
         return false;
     }
 
@@ -84,14 +96,16 @@ bool M5ModuleQRCode::_init_qrcode()
     _config.serial->begin(115200, SERIAL_8N1, _config.pin_rx, _config.pin_tx);
 
     _setup(_config.serial);
+    // May be a different module than before
+    _invalidate_registers();
 
     return true;
 }
 
 bool M5ModuleQRCode::checkConnection()
 {
-    auto version = getFirmwareVersion();
-    return !version.empty();
+    char version[MODULE_QRCODE_INFO_MAX_SIZE];
+    return getFirmwareVersion(version, sizeof(version)) > 0;
 }
 
 void M5ModuleQRCode::setEnable(bool enable)
@@ -102,6 +116,8 @@ void M5ModuleQRCode::setEnable(bool enable)
     } else {
         _pi4ioe5v6408->digitalWrite(CHANNEL_QRCODE_POWER_EN, false);
         setTriggerLevel(false);
+        // Settings are not guaranteed to survive the power cycle
+        _invalidate_registers();
     }
 }
 
@@ -116,13 +132,71 @@ void M5ModuleQRCode::setTriggerLevel(bool level)
 
 void M5ModuleQRCode::update()
 {
+#if MODULE_QRCODE_LOG_DRAIN_PER_UPDATE > 0
+    // Fallback consumer, a few records at a time to keep the scan path short
+    if (!isLogTaskRunning()) {
+        drainLog(MODULE_QRCODE_LOG_DRAIN_PER_UPDATE);
+    }
+#endif
+
+#if MODULE_QRCODE_STATIC_ALLOC
+    _scan_result_len = 0;
+    _scan_result[0]  = '\0';
+#else
     _scan_result.clear();
+#endif
+
+    // Requests triggered while the module is off or warming up still complete as no-read
+    if (_request_tracker) {
+        _request_tracker->update();
+    }
+
+    if (_power_scheduler) {
+        _power_scheduler->update();
+        if (!_power_scheduler->isReady()) {
+            return;
+        }
+    }
 
+#if MODULE_QRCODE_STATIC_ALLOC
+    if (QRCodeM14::available()) {
+        _scan_result_len = waitScanResult(_scan_result, sizeof(_scan_result), 0);
+
+        if (_power_scheduler && available()) {
+            _power_scheduler->onScan();
+        }
+        if (_auto_tuner && available()) {
+            _auto_tuner->onScan(_scan_result, _scan_result_len);
+        }
+        if (_request_tracker && available()) {
+            _request_tracker->onScan(_scan_result, _scan_result_len);
+        }
+
+        if (_on_scan_result && available()) {
+            _on_scan_result(_scan_result, _scan_result_len, _on_scan_result_user_data);
+        }
+    }
+#else
     if (QRCodeM14::available()) {
         waitScanResult(_scan_result, 0);
 
+        if (_power_scheduler && available()) {
+            _power_scheduler->onScan();
+        }
+        if (_auto_tuner && available()) {
+            _auto_tuner->onScan(_scan_result.data(), _scan_result.size());
+        }
+        if (_request_tracker && available()) {
+            _request_tracker->onScan(_scan_result.data(), _scan_result.size());
+        }
+
         if (_on_scan_result && available()) {
             _on_scan_result(_scan_result);
         }
     }
+#endif
+
+    if (_auto_tuner) {
+        _auto_tuner->update();
+    }
 }
@@ -5,12 +5,19 @@
  */
 #pragma once
 #include "qrcode_m14.h"
+#include "qrcode_async.h"
+#include "qrcode_tuner.h"
 #include <Arduino.h>
 #include <M5Unified.h>
 #include <utility/PI4IOE5V6408_Class.hpp>
+#if !MODULE_QRCODE_STATIC_ALLOC
 #include <functional>
 #include <string>
 #include <memory>
+#endif
+
+class QRCodePowerScheduler;
+class QRCodeRequestTracker;
 
 class M5ModuleQRCode : public QRCodeM14 {
 public:
@@ -72,6 +79,58 @@ public:
      */
     void update();
 
+#if MODULE_QRCODE_STATIC_ALLOC
+    /**
+     * @brief Scan result callback.
+     * @param data Scan result, null terminated
+     * @param len Scan result length
+     * @param user_data User data passed to onScanResult()
+     */
+    typedef void (*ScanResultCallback_t)(const char* data, size_t len, void* user_data);
+
+    /**
+     * @brief Check if scan result is available.
+     *
+     * @return true
+     * @return false
+     */
+    inline bool available() const
+    {
+        return _scan_result_len > 0;
+    }
+
+    /**
+     * @brief Get scan result.
+     *
+     * @return const char* Null terminated scan result, valid until next update()
+     */
+    inline const char* getScanResult() const
+    {
+        return _scan_result;
+    }
+
+    /**
+     * @brief Get scan result length.
+     *
+     * @return size_t
+     */
+    inline size_t getScanResultLength() const
+    {
+        return _scan_result_len;
+    }
+
+    /**
+     * @brief Set on scan result callback.
+     *
+     * @param callback
+     * @param user_data
+     */
+    inline void onScanResult(ScanResultCallback_t callback, void* user_data = nullptr)
+    {
+        _on_scan_result           = callback;
+        _on_scan_result_user_data = user_data;
+    }
+#else
     /**
      * @brief Check if scan result is available.
      *
@@ -102,13 +161,59 @@ public:
     {
         _on_scan_result = callback;
     }
+#endif
+
+    /**
+     * @brief Attach an auto tuner, update() then reports every scan result to it and runs it.
+     *
+     * @param tuner Started tuner, nullptr to detach
+     */
+    inline void setAutoTuner(QRCodeAutoTuner* tuner)
+    {
+        _auto_tuner = tuner;
+    }
+
+    /**
+     * @brief Attach a power scheduler, update() then runs it and only reads scan results while it is ready.
+     *
+     * @param scheduler Started scheduler, nullptr to detach
+     */
+    inline void setPowerScheduler(QRCodePowerScheduler* scheduler)
+    {
+        _power_scheduler = scheduler;
+    }
+
+    /**
+     * @brief Attach a request tracker, update() then reports every scan result to it and expires its requests.
+     *
+     * @param tracker Request tracker, nullptr to detach
+     */
+    inline void setRequestTracker(QRCodeRequestTracker* tracker)
+    {
+        _request_tracker = tracker;
+    }
 
 private:
     Config_t _config;
-    m5::PI4IOE5V6408_Class* _pi4ioe5v6408 = nullptr;
+    QRCodeAutoTuner* _auto_tuner           = nullptr;
+    QRCodePowerScheduler* _power_scheduler = nullptr;
+    QRCodeRequestTracker* _request_tracker = nullptr;
+    m5::PI4IOE5V6408_Class* _pi4ioe5v6408  = nullptr;
+#if MODULE_QRCODE_STATIC_ALLOC
+    alignas(m5::PI4IOE5V6408_Class) uint8_t _pi4ioe5v6408_storage[sizeof(m5::PI4IOE5V6408_Class)];
+    char _scan_result[MODULE_QRCODE_RX_BUFFER_SIZE] = {0};
+    size_t _scan_result_len                         = 0;
+    ScanResultCallback_t _on_scan_result            = nullptr;
+    void* _on_scan_result_user_data                 = nullptr;
+#else
     std::string _scan_result;
     std::function<void(const std::string&)> _on_scan_result;
+#endif
 
+    void _release_pi4ioe5v6408();
     bool _init_pi4ioe5v6408();
     bool _init_qrcode();
 };
+
+#include "qrcode_power.h"
+#include "qrcode_request.h"
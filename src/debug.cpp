@@ -0,0 +1,132 @@
+/*
+ * SPDX-FileCopyrightText: 2025 M5Stack Technology CO LTD
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "debug.h"
+#include <atomic>
+
+#if MODULE_QRCODE_LOG_LEVEL > MODULE_QRCODE_LOG_LEVEL_NONE
+
+static_assert((MODULE_QRCODE_LOG_RING_SIZE & (MODULE_QRCODE_LOG_RING_SIZE - 1)) == 0,
+              "MODULE_QRCODE_LOG_RING_SIZE must be a power of 2");
+
+/*
+ * Bounded MPMC ring (Vyukov style). Each slot carries a sequence number that tells whether it is free for the
+ * producer owning position `pos` or filled for the consumer owning it. The stored value is offset by the slot index
+ * so that the zero initialized ring is already in its initial state.
+ */
+struct LogRecord_t {
+    std::atomic<uint32_t> seq;
+    uint32_t time_ms;
+    const char* fmt;
+    uint8_t level;
+    uint8_t argc;
+    uint32_t args[MODULE_QRCODE_LOG_MAX_ARGS];
+};
+
+static LogRecord_t _log_ring[MODULE_QRCODE_LOG_RING_SIZE];
+static std::atomic<uint32_t> _log_head(0);
+static std::atomic<uint32_t> _log_tail(0);
+static std::atomic<uint32_t> _log_dropped(0);
+
+void debug_log_push(uint8_t level, const char* fmt, const uint32_t* args, size_t argc)
+{
+    uint32_t pos = _log_head.load(std::memory_order_relaxed);
+    LogRecord_t* record;
+
+    while (true) {
+        uint32_t index = pos & (MODULE_QRCODE_LOG_RING_SIZE - 1);
+        record         = &_log_ring[index];
+        int32_t diff   = (int32_t)(record->seq.load(std::memory_order_acquire) + index - pos);
+        if (diff == 0) {
+            if (_log_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Ring full, never block the caller
+            _log_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            pos = _log_head.load(std::memory_order_relaxed);
+        }
+    }
+
+    record->time_ms = millis();
+    record->fmt     = fmt;
+    record->level   = level;
+    record->argc    = argc;
+    for (size_t i = 0; i < argc; i++) {
+        record->args[i] = args[i];
+    }
+    record->seq.store(pos + 1 - (pos & (MODULE_QRCODE_LOG_RING_SIZE - 1)), std::memory_order_release);
+}
+
+size_t debug_log_drain(size_t max_records)
+{
+    size_t count = 0;
+    uint32_t pos = _log_tail.load(std::memory_order_relaxed);
+
+    while (count < max_records) {
+        uint32_t index      = pos & (MODULE_QRCODE_LOG_RING_SIZE - 1);
+        LogRecord_t* record = &_log_ring[index];
+        int32_t diff        = (int32_t)(record->seq.load(std::memory_order_acquire) + index - (pos + 1));
+        if (diff < 0) {
+            break;
+        }
+        if (diff > 0) {
+            // Another consumer took this record already
+            pos = _log_tail.load(std::memory_order_relaxed);
+            continue;
+        }
+        // drainLog() and the log task may run at the same time, claim the record before reading it
+        if (!_log_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+            continue;
+        }
+
+        uint32_t args[MODULE_QRCODE_LOG_MAX_ARGS] = {0};
+        for (size_t i = 0; i < record->argc; i++) {
+            args[i] = record->args[i];
+        }
+        const char* fmt = record->fmt;
+        uint8_t level   = record->level;
+        uint32_t time   = record->time_ms;
+
+        record->seq.store(pos + MODULE_QRCODE_LOG_RING_SIZE - index, std::memory_order_release);
+        pos++;
+        count++;
+
+        // Level none is a continuation of the previous record (buffer trace)
+        if (level == MODULE_QRCODE_LOG_LEVEL_ERROR) {
+            printf("[%lu][error] ", (unsigned long)time);
+        } else if (level == MODULE_QRCODE_LOG_LEVEL_DEBUG) {
+            printf("[%lu][debug] ", (unsigned long)time);
+        }
+        printf(fmt, args[0], args[1], args[2], args[3]);
+    }
+
+    return count;
+}
+
+uint32_t debug_log_dropped()
+{
+    return _log_dropped.load(std::memory_order_relaxed);
+}
+
+#else
+
+void debug_log_push(uint8_t, const char*, const uint32_t*, size_t)
+{
+}
+
+size_t debug_log_drain(size_t)
+{
+    return 0;
+}
+
+uint32_t debug_log_dropped()
+{
+    return 0;
+}
+
+#endif
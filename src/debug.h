@@ -6,24 +6,87 @@
 #pragma once
 #include <Arduino.h>
 
-#define MODULE_QRCODE_DEBUG 0
+/*
+ * Log records are not printed by the caller. Each _LOG_xxx pushes a compact binary record (timestamp, level, format
+ * string pointer as event ID and up to 4 integer arguments) into a lock-free ring, which is formatted and printed later
+ * by M5ModuleQRCode::update(), QRCodeM14::drainLog() or the log task. Records are dropped (and counted) when the ring
+ * is full.
+ */
+#define MODULE_QRCODE_LOG_LEVEL_NONE  0
+#define MODULE_QRCODE_LOG_LEVEL_ERROR 1
+#define MODULE_QRCODE_LOG_LEVEL_DEBUG 2
 
-#define _LOG_DEBUG(x, ...)        \
-    if (MODULE_QRCODE_DEBUG) {    \
-        printf("[debug] ");       \
-        printf(x, ##__VA_ARGS__); \
-    }
+#ifndef MODULE_QRCODE_LOG_LEVEL
+#define MODULE_QRCODE_LOG_LEVEL MODULE_QRCODE_LOG_LEVEL_ERROR
+#endif
+
+// Number of records in the log ring, must be a power of 2
+#ifndef MODULE_QRCODE_LOG_RING_SIZE
+#define MODULE_QRCODE_LOG_RING_SIZE 32
+#endif
+
+#define MODULE_QRCODE_LOG_MAX_ARGS 4
+
+// Max records printed per M5ModuleQRCode::update() while the log task is not running, 0 to never print there
+#ifndef MODULE_QRCODE_LOG_DRAIN_PER_UPDATE
+#define MODULE_QRCODE_LOG_DRAIN_PER_UPDATE 1
+#endif
+
+void debug_log_push(uint8_t level, const char* fmt, const uint32_t* args, size_t argc);
+size_t debug_log_drain(size_t max_records);
+uint32_t debug_log_dropped();
 
+template <typename... Args>
+inline void debug_log(uint8_t level, const char* fmt, Args... args)
+{
+    static_assert(sizeof...(Args) <= MODULE_QRCODE_LOG_MAX_ARGS, "too many log arguments");
+    const uint32_t argv[] = {0, static_cast<uint32_t>(args)...};
+    debug_log_push(level, fmt, argv + 1, sizeof...(Args));
+}
+
+#if MODULE_QRCODE_LOG_LEVEL >= MODULE_QRCODE_LOG_LEVEL_DEBUG
+#define _LOG_DEBUG(x, ...)                                          \
+    do {                                                            \
+        debug_log(MODULE_QRCODE_LOG_LEVEL_DEBUG, x, ##__VA_ARGS__); \
+    } while (0)
+#else
+#define _LOG_DEBUG(x, ...) \
+    do {                   \
+    } while (0)
+#endif
+
+#if MODULE_QRCODE_LOG_LEVEL >= MODULE_QRCODE_LOG_LEVEL_ERROR
+#define _LOG_ERROR(x, ...)                                          \
+    do {                                                            \
+        debug_log(MODULE_QRCODE_LOG_LEVEL_ERROR, x, ##__VA_ARGS__); \
+    } while (0)
+#else
 #define _LOG_ERROR(x, ...) \
-    printf("[error] ");    \
-    printf(x, ##__VA_ARGS__);
+    do {                   \
+    } while (0)
+#endif
 
-inline void debug_print_buffer(const uint8_t* buffer, size_t len)
+#if MODULE_QRCODE_LOG_LEVEL >= MODULE_QRCODE_LOG_LEVEL_DEBUG
+inline void _debug_print_buffer(const uint8_t* buffer, size_t len)
 {
-#if MODULE_QRCODE_DEBUG
-    for (size_t i = 0; i < len; i++) {
-        printf("%02X ", buffer[i]);
+    static const char* const chunk_fmt[] = {"", "%02X ", "%02X %02X ", "%02X %02X %02X ", "%02X %02X %02X %02X "};
+
+    while (len > 0) {
+        size_t n = len < MODULE_QRCODE_LOG_MAX_ARGS ? len : MODULE_QRCODE_LOG_MAX_ARGS;
+        uint32_t argv[MODULE_QRCODE_LOG_MAX_ARGS];
+        for (size_t i = 0; i < n; i++) {
+            argv[i] = buffer[i];
+        }
+        debug_log_push(MODULE_QRCODE_LOG_LEVEL_NONE, chunk_fmt[n], argv, n);
+        buffer += n;
+        len -= n;
     }
-    printf("\n");
-#endif
+    debug_log_push(MODULE_QRCODE_LOG_LEVEL_NONE, "\n", nullptr, 0);
 }
+#define debug_print_buffer(buffer, len) _debug_print_buffer(buffer, len)
+#else
+// Arguments are not evaluated when tracing is disabled
+#define debug_print_buffer(buffer, len) \
+    do {                                \
+    } while (0)
+#endif
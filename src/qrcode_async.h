@@ -0,0 +1,426 @@
+/*
+ * SPDX-FileCopyrightText: 2025 M5Stack Technology CO LTD
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include "qrcode_m14.h"
+
+/*
+ * C++20 coroutine API, only available when the toolchain supports coroutines (e.g. arduino-esp32 3.x).
+ *
+ *     QRCodeExecutor executor;
+ *     QRCodeAsync scanner(module_qrcode, executor);
+ *
+ *     QRCodeTask scanWorkflow()
+ *     {
+ *         char code[256];
+ *         co_await scanner.startDecode();
+ *         size_t len = co_await scanner.nextScan(code, sizeof(code), 2000);
+ *         co_await scanner.stopDecode();
+ *     }
+ *
+ *     void loop()
+ *     {
+ *         executor.poll();
+ *     }
+ *
+ * The executor and the awaitables are single threaded: start tasks and call poll() from the same task.
+ */
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#include <coroutine>
+#include <stddef.h>
+#include <stdlib.h>
+
+/**
+ * @brief Number of coroutine frames that can be alive at once.
+ */
+#ifndef MODULE_QRCODE_CORO_POOL_SIZE
+#define MODULE_QRCODE_CORO_POOL_SIZE 2
+#endif
+
+/**
+ * @brief Max size of a coroutine frame, larger coroutines fail to start.
+ */
+#ifndef MODULE_QRCODE_CORO_FRAME_SIZE
+#define MODULE_QRCODE_CORO_FRAME_SIZE 1024
+#endif
+
+/**
+ * @brief Fixed pool of coroutine frames, never touches the heap.
+ */
+class QRCodeFramePool {
+public:
+    static void* alloc(size_t size) noexcept
+    {
+        if (size > MODULE_QRCODE_CORO_FRAME_SIZE) {
+            return nullptr;
+        }
+        for (size_t i = 0; i < MODULE_QRCODE_CORO_POOL_SIZE; i++) {
+            if (!_used[i]) {
+                _used[i] = true;
+                return _frames[i];
+            }
+        }
+        return nullptr;
+    }
+
+    static void free(void* ptr) noexcept
+    {
+        for (size_t i = 0; i < MODULE_QRCODE_CORO_POOL_SIZE; i++) {
+            if (ptr == _frames[i]) {
+                _used[i] = false;
+                return;
+            }
+        }
+    }
+
+    static size_t inUse() noexcept
+    {
+        size_t count = 0;
+        for (size_t i = 0; i < MODULE_QRCODE_CORO_POOL_SIZE; i++) {
+            count += _used[i] ? 1 : 0;
+        }
+        return count;
+    }
+
+private:
+    alignas(max_align_t) static inline uint8_t _frames[MODULE_QRCODE_CORO_POOL_SIZE][MODULE_QRCODE_CORO_FRAME_SIZE];
+    static inline bool _used[MODULE_QRCODE_CORO_POOL_SIZE] = {false};
+};
+
+/**
+ * @brief Fire-and-forget coroutine. It runs on call until its first co_await and frees its frame when it returns.
+ * If no frame is available the coroutine does not run and valid() returns false.
+ */
+class QRCodeTask {
+public:
+    struct promise_type {
+        QRCodeTask get_return_object() noexcept
+        {
+            return QRCodeTask(true);
+        }
+        static QRCodeTask get_return_object_on_allocation_failure() noexcept
+        {
+            return QRCodeTask(false);
+        }
+        std::suspend_never initial_suspend() noexcept
+        {
+            return {};
+        }
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+        void return_void() noexcept
+        {
+        }
+        void unhandled_exception() noexcept
+        {
+            abort();
+        }
+        static void* operator new(size_t size) noexcept
+        {
+            return QRCodeFramePool::alloc(size);
+        }
+        static void operator delete(void* ptr) noexcept
+        {
+            QRCodeFramePool::free(ptr);
+        }
+    };
+
+    inline bool valid() const
+    {
+        return _valid;
+    }
+
+private:
+    explicit QRCodeTask(bool valid) : _valid(valid)
+    {
+    }
+
+    bool _valid;
+};
+
+/**
+ * @brief Resumes suspended coroutines when what they wait for is ready. Pump poll() from loop() or a host event loop.
+ */
+class QRCodeExecutor {
+public:
+    /**
+     * @brief Base of every awaitable, linked into the executor while its coroutine is suspended.
+     */
+    class Waiter {
+    public:
+        virtual ~Waiter() = default;
+
+        /**
+         * @brief Check the awaited condition.
+         * @param timed_out True when the wait timeout has expired
+         * @return true to resume the coroutine
+         */
+        virtual bool check(bool timed_out) = 0;
+
+    protected:
+        explicit Waiter(QRCodeExecutor& executor, uint32_t timeout_ms) : _executor(executor), _timeout_ms(timeout_ms)
+        {
+        }
+
+        inline bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        inline void await_suspend(std::coroutine_handle<> handle) noexcept
+        {
+            _handle   = handle;
+            _start_ms = millis();
+            _executor._add(this);
+        }
+
+    private:
+        friend class QRCodeExecutor;
+
+        QRCodeExecutor& _executor;
+        uint32_t _timeout_ms;
+        uint32_t _start_ms = 0;
+        std::coroutine_handle<> _handle;
+        Waiter* _next = nullptr;
+    };
+
+    /**
+     * @brief Resume every coroutine whose awaited condition is ready.
+     * @return Number of resumed coroutines
+     */
+    size_t poll()
+    {
+        size_t resumed = 0;
+
+        // Detach the list, coroutines that suspend again while resumed here are checked on the next poll()
+        Waiter* waiter = _waiters;
+        _waiters       = nullptr;
+
+        while (waiter != nullptr) {
+            Waiter* next   = waiter->_next;
+            bool timed_out = waiter->_timeout_ms != 0xFFFFFFFF && millis() - waiter->_start_ms >= waiter->_timeout_ms;
+            if (waiter->check(timed_out)) {
+                // The waiter lives in the coroutine frame, do not touch it after resume
+                waiter->_handle.resume();
+                resumed++;
+            } else {
+                _add(waiter);
+            }
+            waiter = next;
+        }
+
+        return resumed;
+    }
+
+    /**
+     * @brief Get the number of suspended coroutines.
+     * @return Pending count
+     */
+    size_t pending() const
+    {
+        size_t count = 0;
+        for (Waiter* waiter = _waiters; waiter != nullptr; waiter = waiter->_next) {
+            count++;
+        }
+        return count;
+    }
+
+private:
+    Waiter* _waiters = nullptr;
+
+    void _add(Waiter* waiter)
+    {
+        waiter->_next = _waiters;
+        _waiters      = waiter;
+    }
+};
+
+/**
+ * @brief Awaitable wrappers of QRCodeM14, they never block the CPU.
+ */
+class QRCodeAsync {
+public:
+    /**
+     * @brief co_await result: scan result length, 0 on timeout.
+     */
+    class ScanAwaiter : public QRCodeExecutor::Waiter {
+    public:
+        ScanAwaiter(QRCodeExecutor& executor, QRCodeM14& device, char* result, size_t result_size, uint32_t timeout_ms)
+            : Waiter(executor, timeout_ms), _device(device), _result(result), _result_size(result_size)
+        {
+        }
+
+        bool check(bool timed_out) override
+        {
+            if (_device.available()) {
+                _len = _device.waitScanResult(_result, _result_size, 0);
+                return true;
+            }
+            return timed_out;
+        }
+
+        using Waiter::await_ready;
+        using Waiter::await_suspend;
+
+        inline size_t await_resume() const noexcept
+        {
+            return _len;
+        }
+
+    private:
+        QRCodeM14& _device;
+        char* _result;
+        size_t _result_size;
+        size_t _len = 0;
+    };
+
+    /**
+     * @brief co_await result: CmdResult_t, as QRCodeM14::sendCmd().
+     */
+    class CommandAwaiter : public QRCodeExecutor::Waiter {
+    public:
+        // The blocking sendCmd() waits 100 ms before it starts counting the ack timeout
+        CommandAwaiter(QRCodeExecutor& executor, QRCodeM14& device, const uint8_t* cmd, size_t cmd_len,
+                       const uint8_t* cmd_ack, size_t ack_len, uint32_t timeout_ms)
+            : Waiter(executor, timeout_ms + 100),
+              _device(device),
+              _cmd(cmd),
+              _cmd_len(cmd_len),
+              _cmd_ack(cmd_ack),
+              _ack_len(ack_len)
+        {
+        }
+
+        bool check(bool timed_out) override
+        {
+            _result = _device._check_ack(_cmd_ack, _ack_len);
+            return _result != QRCodeM14::TIMEOUT || timed_out;
+        }
+
+        bool await_ready() noexcept
+        {
+            if (!_device._write_cmd(_cmd, _cmd_len)) {
+                _result = QRCodeM14::INVALID_PARAM;
+                return true;
+            }
+            // If no response is expected
+            return !_cmd_ack || _ack_len == 0;
+        }
+
+        using Waiter::await_suspend;
+
+        inline QRCodeM14::CmdResult_t await_resume() const noexcept
+        {
+            return _result;
+        }
+
+    private:
+        QRCodeM14& _device;
+        const uint8_t* _cmd;
+        size_t _cmd_len;
+        const uint8_t* _cmd_ack;
+        size_t _ack_len;
+        QRCodeM14::CmdResult_t _result = QRCodeM14::SUCCESS;
+    };
+
+    /**
+     * @brief co_await suspends the coroutine for the given time.
+     */
+    class SleepAwaiter : public QRCodeExecutor::Waiter {
+    public:
+        SleepAwaiter(QRCodeExecutor& executor, uint32_t delay_ms) : Waiter(executor, delay_ms)
+        {
+        }
+
+        bool check(bool timed_out) override
+        {
+            return timed_out;
+        }
+
+        using Waiter::await_ready;
+        using Waiter::await_suspend;
+
+        inline void await_resume() const noexcept
+        {
+        }
+    };
+
+    QRCodeAsync(QRCodeM14& device, QRCodeExecutor& executor) : _device(device), _executor(executor)
+    {
+    }
+
+    /**
+     * @brief Wait for the next scan result.
+     * @param result Scan result buffer, always null terminated
+     * @param result_size Scan result buffer size
+     * @param timeout_ms Timeout in milliseconds (default: infinite)
+     */
+    inline ScanAwaiter nextScan(char* result, size_t result_size, uint32_t timeout_ms = 0xFFFFFFFF)
+    {
+        return ScanAwaiter(_executor, _device, result, result_size, timeout_ms);
+    }
+
+    /**
+     * @brief Send command and wait for its ack. Buffers must stay valid until the co_await completes.
+     * @param cmd Command data pointer
+     * @param cmd_len Command data length
+     * @param cmd_ack Expected acknowledgment data (optional)
+     * @param ack_len Acknowledgment data length (optional)
+     * @param timeout_ms Timeout in milliseconds (default: 1000)
+     */
+    inline CommandAwaiter command(const uint8_t* cmd, size_t cmd_len, const uint8_t* cmd_ack = nullptr,
+                                  size_t ack_len = 0, uint32_t timeout_ms = 1000)
+    {
+        return CommandAwaiter(_executor, _device, cmd, cmd_len, cmd_ack, ack_len, timeout_ms);
+    }
+
+    template <size_t N>
+    inline CommandAwaiter command(const uint8_t (&cmd)[N])
+    {
+        return command(cmd, N);
+    }
+
+    template <size_t N, size_t M>
+    inline CommandAwaiter command(const uint8_t (&cmd)[N], const uint8_t (&cmd_ack)[M], uint32_t timeout_ms = 1000)
+    {
+        return command(cmd, N, cmd_ack, M, timeout_ms);
+    }
+
+    /**
+     * @brief Start decoding.
+     */
+    inline CommandAwaiter startDecode()
+    {
+        static const uint8_t cmd[] = {0x32, 0x75, 0x01};
+        return command(cmd);
+    }
+
+    /**
+     * @brief Stop decoding.
+     */
+    inline CommandAwaiter stopDecode()
+    {
+        static const uint8_t cmd[]     = {0x32, 0x75, 0x02};
+        static const uint8_t cmd_ack[] = {0x33, 0x75, 0x02, 0x00, 0x00};
+        return command(cmd, cmd_ack, 150);
+    }
+
+    /**
+     * @brief Suspend the coroutine without blocking the CPU.
+     * @param delay_ms Delay time in milliseconds
+     */
+    inline SleepAwaiter sleep(uint32_t delay_ms)
+    {
+        return SleepAwaiter(_executor, delay_ms);
+    }
+
+private:
+    QRCodeM14& _device;
+    QRCodeExecutor& _executor;
+};
+
+#endif
@@ -0,0 +1,88 @@
+/*
+ * SPDX-FileCopyrightText: 2025 M5Stack Technology CO LTD
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "qrcode_frame.h"
+
+// Non zero if any byte of v is zero
+static inline uint32_t _has_zero_byte(uint32_t v)
+{
+    return (v - 0x01010101u) & ~v & 0x80808080u;
+}
+
+const uint8_t* QRCodeFrameScanner::findAny(const uint8_t* data, size_t len, uint8_t a, uint8_t b)
+{
+    if (!data) {
+        return nullptr;
+    }
+
+    const uint32_t pattern_a = 0x01010101u * a;
+    const uint32_t pattern_b = 0x01010101u * b;
+
+    // Skip whole words without a match, then locate the byte
+    size_t i = 0;
+    for (; i + sizeof(uint32_t) <= len; i += sizeof(uint32_t)) {
+        uint32_t word;
+        memcpy(&word, data + i, sizeof(word));
+        if (_has_zero_byte(word ^ pattern_a) | _has_zero_byte(word ^ pattern_b)) {
+            break;
+        }
+    }
+    for (; i < len; i++) {
+        if (data[i] == a || data[i] == b) {
+            return data + i;
+        }
+    }
+
+    return nullptr;
+}
+
+QRCodeFrameScanner::Status_t QRCodeFrameScanner::findResponse(const uint8_t* data, size_t len, const uint8_t* cmd,
+                                                              size_t max_payload, Frame_t& frame)
+{
+    if (!data || !cmd) {
+        return FRAME_NOT_FOUND;
+    }
+
+    const uint8_t opcode     = cmd[0];
+    const uint8_t opcode_ack = cmd[0] + 1;
+
+    size_t pos = 0;
+    while (pos < len) {
+        const uint8_t* header = findAny(data + pos, len - pos, opcode, opcode_ack);
+        if (!header) {
+            break;
+        }
+
+        size_t offset = header - data;
+        size_t remain = len - offset;
+
+        if (remain < HEADER_SIZE) {
+            // Truncated header, trust it as long as the received bytes match
+            if ((remain < 2 || header[1] == cmd[1]) && (remain < 3 || header[2] == cmd[2])) {
+                frame.offset      = offset;
+                frame.payload_len = 0;
+                frame.payload     = nullptr;
+                return FRAME_PARTIAL;
+            }
+        } else if (header[1] == cmd[1] && header[2] == cmd[2]) {
+            size_t payload_len = (static_cast<size_t>(header[3]) << 8) | header[4];
+            if (payload_len > 0 && payload_len <= max_payload) {
+                frame.offset      = offset;
+                frame.payload_len = payload_len;
+                if (remain < HEADER_SIZE + payload_len) {
+                    frame.payload = nullptr;
+                    return FRAME_PARTIAL;
+                }
+                frame.payload = header + HEADER_SIZE;
+                return FRAME_FOUND;
+            }
+        }
+
+        // Not a valid header, resync at the next byte
+        pos = offset + 1;
+    }
+
+    return FRAME_NOT_FOUND;
+}
@@ -0,0 +1,50 @@
+/*
+ * SPDX-FileCopyrightText: 2025 M5Stack Technology CO LTD
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include <Arduino.h>
+
+/**
+ * @brief Locates command responses in raw rx data.
+ *
+ * Responses look like {opcode, cmd[1], cmd[2], len_hi, len_lo, payload...}, with opcode cmd[0] or cmd[0] + 1. A
+ * candidate header is only trusted when the opcode, both echoed command bytes and the length check out. Otherwise the
+ * search resumes at the next byte, so stray scan data or corruption before a response is skipped. Byte searches work a
+ * 32-bit word at a time.
+ */
+class QRCodeFrameScanner {
+public:
+    static constexpr size_t HEADER_SIZE = 5;
+
+    enum Status_t {
+        FRAME_FOUND = 0,  // Complete frame
+        FRAME_PARTIAL,    // Valid header, payload not fully received yet
+        FRAME_NOT_FOUND   // No valid header
+    };
+
+    struct Frame_t {
+        size_t offset;       // Header position in the buffer
+        size_t payload_len;  // Payload length from the header
+        const uint8_t* payload;
+    };
+
+    /**
+     * @brief Find a response to a command.
+     * @param data Rx data
+     * @param len Rx data length
+     * @param cmd Command the response answers, at least 3 bytes
+     * @param max_payload Reject headers announcing a larger payload
+     * @param frame Found frame, payload is only valid for FRAME_FOUND
+     * @return Frame status
+     */
+    static Status_t findResponse(const uint8_t* data, size_t len, const uint8_t* cmd, size_t max_payload,
+                                 Frame_t& frame);
+
+    /**
+     * @brief Find the first byte equal to a or b.
+     * @return Byte position, nullptr if none
+     */
+    static const uint8_t* findAny(const uint8_t* data, size_t len, uint8_t a, uint8_t b);
+};
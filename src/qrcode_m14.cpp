@@ -5,6 +5,14 @@
  */
 #include "qrcode_m14.h"
 #include "debug.h"
+#include "qrcode_frame.h"
+#include <atomic>
+
+#if MODULE_QRCODE_COUNT_ALLOC
+#include <cstddef>
+#include <new>
+#include <stdlib.h>
+#endif
 
 /* -------------------------------------------------------------------------- */
 /*                                Communication                               */
@@ -12,69 +20,136 @@
 QRCodeM14::CmdResult_t QRCodeM14::sendCmd(const uint8_t* cmd, size_t cmd_len, const uint8_t* cmd_ack, size_t ack_len,
                                           uint32_t timeout_ms)
 {
-    if (!_qrcode_serial || !cmd || cmd_len == 0) {
+    if (!_write_cmd(cmd, cmd_len)) {
         return CmdResult_t::INVALID_PARAM;
     }
 
+    // If no response is expected
+    if (!cmd_ack || ack_len == 0) {
+        return CmdResult_t::SUCCESS;
+    }
+
+    delay(100);
+
+    // Wait for response
+    uint32_t start_time = millis();
+    while (millis() - start_time < timeout_ms) {
+        CmdResult_t result = _check_ack(cmd_ack, ack_len);
+        if (result != CmdResult_t::TIMEOUT) {
+            return result;
+        }
+        delay(5);
+    }
+
+    return CmdResult_t::TIMEOUT;
+}
+
+bool QRCodeM14::_write_cmd(const uint8_t* cmd, size_t cmd_len)
+{
+    if (!_qrcode_serial || !cmd || cmd_len == 0) {
+        return false;
+    }
+
     // Clear rx buffer
     while (_qrcode_serial->available()) {
         _qrcode_serial->read();
     }
+    _ack_pos   = 0;
+    _ack_match = true;
 
     // Send command
     _LOG_DEBUG("tx: ");
     debug_print_buffer(cmd, cmd_len);
 
     _qrcode_serial->write(cmd, cmd_len);
+    return true;
+}
 
-    // If no response is expected
-    if (!cmd_ack || ack_len == 0) {
-        return CmdResult_t::SUCCESS;
-    }
-
-    delay(100);
-
-    // Wait for response
-    uint32_t start_time = millis();
-    while (millis() - start_time < timeout_ms) {
-        if (_qrcode_serial->available() >= ack_len) {
-            uint8_t rx[ack_len];
-            _qrcode_serial->readBytes(rx, ack_len);
+QRCodeM14::CmdResult_t QRCodeM14::_check_ack(const uint8_t* cmd_ack, size_t ack_len)
+{
+    // The ack starts with {opcode, cmd[1], cmd[2]}, anything before that header (e.g. a scan result that completed
+    // while the command was sent) is skipped. Bytes are read one at a time so nothing after the ack is consumed.
+    size_t header_len = min(ack_len, (size_t)3);
 
-            _LOG_DEBUG("rx: ");
-            debug_print_buffer(rx, ack_len);
+    while (_ack_pos < ack_len && _qrcode_serial->available() > 0) {
+        uint8_t byte = _qrcode_serial->read();
 
-            if (memcmp(rx, cmd_ack, ack_len) == 0) {
-                return CmdResult_t::SUCCESS;
+        if (_ack_pos < header_len) {
+            if (byte == cmd_ack[_ack_pos]) {
+                _ack_pos++;
             } else {
-                return CmdResult_t::ACK_MISMATCH;
+                if (_ack_pos > 0) {
+                    _LOG_DEBUG("ack resync after %d bytes\n", _ack_pos);
+                }
+                _ack_pos = byte == cmd_ack[0] ? 1 : 0;
             }
+            continue;
         }
-        delay(5);
+
+        _ack_match &= byte == cmd_ack[_ack_pos];
+        _ack_pos++;
     }
 
-    return CmdResult_t::TIMEOUT;
+    if (_ack_pos < ack_len) {
+        return CmdResult_t::TIMEOUT;
+    }
+
+    if (!_ack_match) {
+        _LOG_DEBUG("ack value mismatch\n");
+        return CmdResult_t::ACK_MISMATCH;
+    }
+    return CmdResult_t::SUCCESS;
 }
 
-void QRCodeM14::waitResponse(std::vector<uint8_t>& response, uint32_t timeout_ms)
+size_t QRCodeM14::waitResponse(uint8_t* response, size_t response_size, uint32_t timeout_ms)
 {
-    response.clear();
+    if (!response || response_size == 0) {
+        return 0;
+    }
+
     uint32_t start_time = millis();
     do {
         int bytes_num = _qrcode_serial->available();
         if (bytes_num > 0) {
-            response.resize(bytes_num);
-            _qrcode_serial->readBytes(response.data(), bytes_num);
-            break;
+            size_t len = min((size_t)bytes_num, response_size);
+            return _qrcode_serial->readBytes(response, len);
         }
         delay(20);
     } while (millis() - start_time < timeout_ms);
+
+    return 0;
 }
 
-uint16_t QRCodeM14::getResponseDataSize(std::vector<uint8_t>& response)
+uint16_t QRCodeM14::getResponseDataSize(const uint8_t* response, size_t len, const uint8_t* cmd)
 {
-    if (response.size() < 5) {
-        _LOG_ERROR("invaild response size: %d\n", response.size());
+    QRCodeFrameScanner::Frame_t frame;
+    auto status = QRCodeFrameScanner::findResponse(response, len, cmd, 0xFFFF, frame);
+
+    // A partial frame is fine as long as the whole header is there
+    if (status == QRCodeFrameScanner::FRAME_NOT_FOUND || frame.offset != 0 || frame.payload_len == 0) {
+        _LOG_ERROR("invalid response header\n");
+        return 0;
+    }
+    return frame.payload_len;
+}
+
+uint16_t QRCodeM14::checkResponseDataSize(const uint8_t* response, size_t len, const uint8_t* cmd)
+{
+    QRCodeFrameScanner::Frame_t frame;
+    auto status = QRCodeFrameScanner::findResponse(response, len, cmd, 0xFFFF, frame);
+
+    if (status != QRCodeFrameScanner::FRAME_FOUND || frame.offset != 0) {
+        _LOG_ERROR("invalid or incomplete response: %d bytes\n", len);
+        return 0;
+    }
+    return frame.payload_len;
+}
+
+// Unvalidated header read behind the deprecated overloads
+static uint16_t _header_data_size(const uint8_t* response, size_t len)
+{
+    if (!response || len < QRCodeFrameScanner::HEADER_SIZE) {
+        _LOG_ERROR("invaild response size: %d\n", len);
         return 0;
     }
 
@@ -82,23 +157,74 @@ uint16_t QRCodeM14::getResponseDataSize(std::vector<uint8_t>& response)
     return size;
 }
 
-uint16_t QRCodeM14::checkResponseDataSize(std::vector<uint8_t>& response)
+uint16_t QRCodeM14::getResponseDataSize(const uint8_t* response, size_t len)
+{
+    return _header_data_size(response, len);
+}
+
+uint16_t QRCodeM14::checkResponseDataSize(const uint8_t* response, size_t len)
 {
-    uint16_t data_size = getResponseDataSize(response);
+    uint16_t data_size = _header_data_size(response, len);
     if (data_size == 0) {
         return 0;
     }
 
-    size_t data_start_index = 5;
-
-    if (response.size() < data_start_index + data_size) {
-        _LOG_ERROR("invaild data size: %d < %d\n", response.size(), data_start_index + data_size);
+    if (len < QRCodeFrameScanner::HEADER_SIZE + data_size) {
+        _LOG_ERROR("invaild data size: %d < %d\n", len, QRCodeFrameScanner::HEADER_SIZE + data_size);
         return 0;
     }
 
     return data_size;
 }
 
+size_t QRCodeM14::waitScanResult(char* result, size_t result_size, uint32_t timeout_ms)
+{
+    if (!result || result_size == 0) {
+        return 0;
+    }
+
+    size_t len  = waitResponse(reinterpret_cast<uint8_t*>(result), result_size - 1, timeout_ms);
+    result[len] = '\0';
+    return len;
+}
+
+const char* QRCodeM14::cmdResultToCStr(QRCodeM14::CmdResult_t result)
+{
+    static constexpr const char* result_str[] = {"success", "invalid param", "timeout", "ack mismatch"};
+
+    if (result < 0 || result >= sizeof(result_str) / sizeof(result_str[0])) {
+        return "unknown result";
+    }
+    return result_str[result];
+}
+
+#if !MODULE_QRCODE_STATIC_ALLOC
+uint16_t QRCodeM14::getResponseDataSize(std::vector<uint8_t>& response)
+{
+    return _header_data_size(response.data(), response.size());
+}
+
+uint16_t QRCodeM14::checkResponseDataSize(std::vector<uint8_t>& response)
+{
+    uint16_t data_size = _header_data_size(response.data(), response.size());
+    return response.size() < QRCodeFrameScanner::HEADER_SIZE + data_size ? 0 : data_size;
+}
+
+void QRCodeM14::waitResponse(std::vector<uint8_t>& response, uint32_t timeout_ms)
+{
+    response.clear();
+    uint32_t start_time = millis();
+    do {
+        int bytes_num = _qrcode_serial->available();
+        if (bytes_num > 0) {
+            response.resize(bytes_num);
+            _qrcode_serial->readBytes(response.data(), bytes_num);
+            break;
+        }
+        delay(20);
+    } while (millis() - start_time < timeout_ms);
+}
+
 void QRCodeM14::waitScanResult(std::string& result, uint32_t timeout_ms)
 {
     result.clear();
@@ -106,23 +232,474 @@ void QRCodeM14::waitScanResult(std::string& result, uint32_t timeout_ms)
     waitResponse(response, timeout_ms);
     result = std::string(response.begin(), response.end());
 }
+#endif
+
+/* -------------------------------------------------------------------------- */
+/*                                     Log                                    */
+/* -------------------------------------------------------------------------- */
+size_t QRCodeM14::drainLog(size_t max_records)
+{
+    return debug_log_drain(max_records);
+}
+
+uint32_t QRCodeM14::getLogDropCount()
+{
+    return debug_log_dropped();
+}
+
+#if defined(ESP_PLATFORM)
+static void _log_task(void* arg)
+{
+    uint32_t interval_ms = (uint32_t)(uintptr_t)arg;
+    while (true) {
+        debug_log_drain(SIZE_MAX);
+        vTaskDelay(pdMS_TO_TICKS(interval_ms));
+    }
+}
+
+static std::atomic<bool> _log_task_running(false);
+
+bool QRCodeM14::startLogTask(UBaseType_t priority, uint32_t interval_ms)
+{
+    if (_log_task_running.exchange(true)) {
+        return true;
+    }
+    if (xTaskCreate(_log_task, "qrcode_log", 3072, (void*)(uintptr_t)interval_ms, priority, nullptr) != pdPASS) {
+        _log_task_running = false;
+        return false;
+    }
+    return true;
+}
+
+bool QRCodeM14::isLogTaskRunning()
+{
+    return _log_task_running;
+}
+#else
+bool QRCodeM14::isLogTaskRunning()
+{
+    return false;
+}
+#endif
+
+/* -------------------------------------------------------------------------- */
+/*                              Allocation count                              */
+/* -------------------------------------------------------------------------- */
+#if MODULE_QRCODE_COUNT_ALLOC
+static std::atomic<uint32_t> _alloc_count(0);
+
+// Standard operator new behaviour: retry through the new_handler, then report the failure
+static void* _counted_alloc(size_t size, size_t alignment, bool nothrow)
+{
+    _alloc_count.fetch_add(1, std::memory_order_relaxed);
+    if (size == 0) {
+        size = 1;
+    }
+
+    while (true) {
+        void* ptr;
+        if (alignment > alignof(std::max_align_t)) {
+            // aligned_alloc() wants a multiple of the alignment
+            ptr = aligned_alloc(alignment, (size + alignment - 1) & ~(alignment - 1));
+        } else {
+            ptr = malloc(size);
+        }
+        if (ptr != nullptr) {
+            return ptr;
+        }
+
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr) {
+            break;
+        }
+        handler();
+    }
+
+    if (nothrow) {
+        return nullptr;
+    }
+#if defined(__cpp_exceptions)
+    throw std::bad_alloc();
+#else
+    abort();
+#endif
+}
+
+void* operator new(size_t size)
+{
+    return _counted_alloc(size, 0, false);
+}
+
+void* operator new[](size_t size)
+{
+    return _counted_alloc(size, 0, false);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return _counted_alloc(size, 0, true);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return _counted_alloc(size, 0, true);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+    free(ptr);
+}
 
-std::string QRCodeM14::cmdResultToString(QRCodeM14::CmdResult_t result)
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
 {
-    switch (result) {
-        case QRCodeM14::CmdResult_t::SUCCESS:
-            return "success";
-        case QRCodeM14::CmdResult_t::INVALID_PARAM:
-            return "invalid param";
+    free(ptr);
+}
+
+#if defined(__cpp_aligned_new)
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    return _counted_alloc(size, static_cast<size_t>(alignment), false);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    return _counted_alloc(size, static_cast<size_t>(alignment), false);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return _counted_alloc(size, static_cast<size_t>(alignment), true);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return _counted_alloc(size, static_cast<size_t>(alignment), true);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    free(ptr);
+}
+#endif
+
+uint32_t QRCodeM14::getAllocCount()
+{
+    return _alloc_count.load(std::memory_order_relaxed);
+}
+#else
+uint32_t QRCodeM14::getAllocCount()
+{
+    return 0;
+}
+#endif
+
+/* -------------------------------------------------------------------------- */
+/*                                  Registers                                 */
+/* -------------------------------------------------------------------------- */
+namespace {
+
+enum AckType_t {
+    ACK_NONE = 0,  // No response
+    ACK_ZERO,      // {0x22, c1, c2, 0x00}
+    ACK_ZERO2,     // {0x22, c1, c2, 0x00, 0x00}
+    ACK_ECHO,      // {0x22, c1, c2, value}
+    ACK_ECHO_ZERO  // {0x22, c1, c2, value, 0x00}
+};
+
+struct RegisterInfo_t {
+    uint8_t cmd[3];
+    uint8_t width;  // Value bytes, big endian
+    uint8_t ack;
+    uint16_t timeout_ms;
+};
+
+// Indexed by QRCodeM14::Register_t, the order is part of the config blob format
+constexpr RegisterInfo_t register_info[] = {
+    {{0x21, 0x61, 0x41}, 1, ACK_ECHO_ZERO, 200},  // REG_TRIGGER_MODE
+    {{0x21, 0x61, 0x8A}, 2, ACK_ZERO2, 200},      // REG_DECODE_DELAY
+    {{0x21, 0x61, 0x82}, 2, ACK_ZERO2, 200},      // REG_TRIGGER_TIMEOUT
+    {{0x21, 0x61, 0x44}, 1, ACK_ZERO, 200},       // REG_MOTION_SENSITIVITY
+    {{0x21, 0x61, 0x8C}, 2, ACK_ZERO2, 200},      // REG_CONTINUOUS_DECODE_DELAY
+    {{0x21, 0x61, 0x85}, 2, ACK_ZERO2, 200},      // REG_TRIGGER_DECODE_DELAY
+    {{0x21, 0x64, 0x82}, 2, ACK_ZERO2, 200},      // REG_SAME_CODE_INTERVAL
+    {{0x21, 0x64, 0x81}, 2, ACK_ZERO2, 200},      // REG_DIFF_CODE_INTERVAL
+    {{0x21, 0x64, 0x43}, 1, ACK_ECHO_ZERO, 200},  // REG_SAME_CODE_NO_DELAY
+    {{0x21, 0x62, 0x41}, 1, ACK_ECHO_ZERO, 200},  // REG_FILL_LIGHT_MODE
+    {{0x21, 0x62, 0x48}, 1, ACK_ECHO_ZERO, 100},  // REG_FILL_LIGHT_BRIGHTNESS
+    {{0x21, 0x62, 0x42}, 1, ACK_ECHO_ZERO, 100},  // REG_POS_LIGHT_MODE
+    {{0x21, 0x63, 0x45}, 1, ACK_ECHO, 150},       // REG_STARTUP_TONE
+    {{0x21, 0x63, 0x42}, 1, ACK_ECHO, 150},       // REG_DECODE_SUCCESS_BEEP
+    {{0x21, 0x51, 0x48}, 1, ACK_ZERO, 200},       // REG_CASE_CONVERSION
+    {{0x21, 0x51, 0x43}, 1, ACK_ZERO, 200},       // REG_PROTOCOL_FORMAT
+    {{0x21, 0x42, 0x40}, 1, ACK_NONE, 0},         // REG_USB_MODE
+};
+
+// Config blob: magic "QM", version, register mask (uint32 LE), values of the set registers, fletcher-16 (LE)
+constexpr uint8_t CONFIG_MAGIC_0 = 'Q';
+constexpr uint8_t CONFIG_MAGIC_1 = 'M';
+constexpr uint8_t CONFIG_VERSION = 1;
+constexpr size_t CONFIG_HEADER   = 7;
+
+uint16_t _fletcher16(const uint8_t* data, size_t len)
+{
+    uint16_t sum1 = 0;
+    uint16_t sum2 = 0;
+    for (size_t i = 0; i < len; i++) {
+        sum1 = (sum1 + data[i]) % 255;
+        sum2 = (sum2 + sum1) % 255;
+    }
+    return (sum2 << 8) | sum1;
+}
+
+}  // namespace
+
+size_t QRCodeM14::_build_register_cmd(Register_t reg, uint16_t value, uint8_t* cmd, uint8_t* cmd_ack,
+                                      size_t* ack_len)
+{
+    static_assert(sizeof(register_info) / sizeof(register_info[0]) == REG_COUNT, "register table size");
+    static_assert(CONFIG_BLOB_MAX_SIZE >= CONFIG_HEADER + 6 * 2 + 11 + 2, "config blob size");
+
+    const RegisterInfo_t& info = register_info[reg];
+    uint8_t low_byte           = value & 0xFF;
+    size_t cmd_len             = 3;
+
+    memcpy(cmd, info.cmd, 3);
+    if (info.width == 2) {
+        cmd[cmd_len++] = (value >> 8) & 0xFF;
+    }
+    cmd[cmd_len++] = low_byte;
+
+    cmd_ack[0] = info.cmd[0] + 1;
+    cmd_ack[1] = info.cmd[1];
+    cmd_ack[2] = info.cmd[2];
+    switch (info.ack) {
+        case ACK_ZERO:
+            cmd_ack[3] = 0x00;
+            *ack_len   = 4;
+            break;
+        case ACK_ZERO2:
+            cmd_ack[3] = 0x00;
+            cmd_ack[4] = 0x00;
+            *ack_len   = 5;
+            break;
+        case ACK_ECHO:
+            cmd_ack[3] = low_byte;
+            *ack_len   = 4;
             break;
-        case QRCodeM14::CmdResult_t::TIMEOUT:
-            return "timeout";
-        case QRCodeM14::CmdResult_t::ACK_MISMATCH:
-            return "ack mismatch";
+        case ACK_ECHO_ZERO:
+            cmd_ack[3] = low_byte;
+            cmd_ack[4] = 0x00;
+            *ack_len   = 5;
             break;
         default:
-            return "unknown result";
+            *ack_len = 0;
+            break;
+    }
+
+    return cmd_len;
+}
+
+QRCodeM14::CmdResult_t QRCodeM14::_set_register(Register_t reg, uint16_t value, bool persist)
+{
+    uint8_t cmd[5];
+    uint8_t cmd_ack[5];
+    size_t ack_len;
+    size_t cmd_len = _build_register_cmd(reg, value, cmd, cmd_ack, &ack_len);
+
+    CmdResult_t result = sendCmd(cmd, cmd_len, cmd_ack, ack_len, register_info[reg].timeout_ms);
+    if (persist) {
+        _remember_register(reg, value, result);
+    } else {
+        // The module no longer holds the configured value
+        _register_synced_mask &= ~(1UL << reg);
     }
+    return result;
+}
+
+QRCodeM14::CmdResult_t QRCodeM14::_write_register(Register_t reg, uint16_t value, bool persist)
+{
+    uint8_t cmd[5];
+    uint8_t cmd_ack[5];
+    size_t ack_len;
+    size_t cmd_len = _build_register_cmd(reg, value, cmd, cmd_ack, &ack_len);
+
+    CmdResult_t result = _write_cmd(cmd, cmd_len) ? CmdResult_t::SUCCESS : CmdResult_t::INVALID_PARAM;
+    if (result == CmdResult_t::SUCCESS && ack_len > 0) {
+        uint32_t start_time = millis();
+        do {
+            result = _check_ack(cmd_ack, ack_len);
+            if (result != CmdResult_t::TIMEOUT) {
+                break;
+            }
+            delay(1);
+        } while (millis() - start_time < 100UL + register_info[reg].timeout_ms);
+    }
+
+    if (persist) {
+        _remember_register(reg, value, result);
+    } else {
+        _register_synced_mask &= ~(1UL << reg);
+    }
+    return result;
+}
+
+void QRCodeM14::_remember_register(Register_t reg, uint16_t value, CmdResult_t result)
+{
+    if (result == CmdResult_t::SUCCESS) {
+        // Keep what was actually written
+        _register_values[reg] = register_info[reg].width == 2 ? value : value & 0xFF;
+        _register_mask |= 1UL << reg;
+        _register_synced_mask |= 1UL << reg;
+    } else {
+        // The module state is unknown now, the configured value stays in the snapshot
+        _register_synced_mask &= ~(1UL << reg);
+    }
+}
+
+size_t QRCodeM14::exportConfig(uint8_t* blob, size_t blob_size)
+{
+    if (!blob) {
+        return 0;
+    }
+
+    size_t len = CONFIG_HEADER;
+    for (int reg = 0; reg < REG_COUNT; reg++) {
+        if (_register_mask & (1UL << reg)) {
+            len += register_info[reg].width;
+        }
+    }
+    if (blob_size < len + 2) {
+        return 0;
+    }
+
+    blob[0] = CONFIG_MAGIC_0;
+    blob[1] = CONFIG_MAGIC_1;
+    blob[2] = CONFIG_VERSION;
+    blob[3] = _register_mask & 0xFF;
+    blob[4] = (_register_mask >> 8) & 0xFF;
+    blob[5] = (_register_mask >> 16) & 0xFF;
+    blob[6] = (_register_mask >> 24) & 0xFF;
+
+    size_t pos = CONFIG_HEADER;
+    for (int reg = 0; reg < REG_COUNT; reg++) {
+        if (!(_register_mask & (1UL << reg))) {
+            continue;
+        }
+        if (register_info[reg].width == 2) {
+            blob[pos++] = (_register_values[reg] >> 8) & 0xFF;
+        }
+        blob[pos++] = _register_values[reg] & 0xFF;
+    }
+
+    uint16_t checksum = _fletcher16(blob, pos);
+    blob[pos++]       = checksum & 0xFF;
+    blob[pos++]       = checksum >> 8;
+
+    return pos;
+}
+
+QRCodeM14::CmdResult_t QRCodeM14::importConfig(const uint8_t* blob, size_t len, bool force)
+{
+    if (!blob || len < CONFIG_HEADER + 2 || blob[0] != CONFIG_MAGIC_0 || blob[1] != CONFIG_MAGIC_1 ||
+        blob[2] != CONFIG_VERSION) {
+        _LOG_ERROR("invalid config blob\n");
+        return CmdResult_t::INVALID_PARAM;
+    }
+
+    uint16_t checksum = blob[len - 2] | (blob[len - 1] << 8);
+    if (_fletcher16(blob, len - 2) != checksum) {
+        _LOG_ERROR("config blob checksum mismatch\n");
+        return CmdResult_t::INVALID_PARAM;
+    }
+
+    uint32_t mask = blob[3] | (blob[4] << 8) | ((uint32_t)blob[5] << 16) | ((uint32_t)blob[6] << 24);
+    if (mask >> REG_COUNT) {
+        return CmdResult_t::INVALID_PARAM;
+    }
+
+    // Decode and validate the whole blob before touching the module
+    uint16_t values[REG_COUNT];
+    size_t pos = CONFIG_HEADER;
+    for (int reg = 0; reg < REG_COUNT; reg++) {
+        if (!(mask & (1UL << reg))) {
+            continue;
+        }
+        if (pos + register_info[reg].width > len - 2) {
+            return CmdResult_t::INVALID_PARAM;
+        }
+        values[reg] = 0;
+        for (uint8_t i = 0; i < register_info[reg].width; i++) {
+            values[reg] = (values[reg] << 8) | blob[pos++];
+        }
+    }
+    if (pos != len - 2) {
+        return CmdResult_t::INVALID_PARAM;
+    }
+
+    // Skip registers known to hold the value already
+    CmdResult_t status = CmdResult_t::SUCCESS;
+    for (int reg = 0; reg < REG_COUNT; reg++) {
+        Register_t r = (Register_t)reg;
+        if (!(mask & (1UL << reg))) {
+            continue;
+        }
+        if (!force && (_register_synced_mask & (1UL << reg)) && _register_values[reg] == values[reg]) {
+            continue;
+        }
+
+        CmdResult_t result = _write_register(r, values[reg]);
+        if (result != CmdResult_t::SUCCESS) {
+            _LOG_ERROR("import register %d failed: %d\n", reg, result);
+            status = result;
+        }
+    }
+
+    return status;
 }
 
 /* -------------------------------------------------------------------------- */
@@ -143,163 +720,154 @@ void QRCodeM14::stopDecode()
 
 void QRCodeM14::setTriggerMode(TriggerMode_t mode)
 {
-    const uint8_t cmd[]     = {0x21, 0x61, 0x41, (uint8_t)mode};
-    const uint8_t cmd_ack[] = {0x22, 0x61, 0x41, (uint8_t)mode, 0x00};
-    sendCmd(cmd, sizeof(cmd), cmd_ack, sizeof(cmd_ack), 200);
+    _set_register(REG_TRIGGER_MODE, (uint8_t)mode);
 }
 
 void QRCodeM14::setDecodeDelay(int delay_ms)
 {
-    uint8_t high_byte       = (delay_ms >> 8) & 0xFF;
-    uint8_t low_byte        = delay_ms & 0xFF;
-    const uint8_t cmd[]     = {0x21, 0x61, 0x8A, high_byte, low_byte};
-    const uint8_t cmd_ack[] = {0x22, 0x61, 0x8A, 0x00, 0x00};
-    sendCmd(cmd, sizeof(cmd), cmd_ack, sizeof(cmd_ack), 200);
+    _set_register(REG_DECODE_DELAY, delay_ms);
 }
 
 void QRCodeM14::setTriggerTimeout(int timeout_ms)
 {
-    uint8_t high_byte       = (timeout_ms >> 8) & 0xFF;
-    uint8_t low_byte        = timeout_ms & 0xFF;
-    const uint8_t cmd[]     = {0x21, 0x61, 0x82, high_byte, low_byte};
-    const uint8_t cmd_ack[] = {0x22, 0x61, 0x82, 0x00, 0x00};
-    sendCmd(cmd, sizeof(cmd), cmd_ack, sizeof(cmd_ack), 200);
+    _set_register(REG_TRIGGER_TIMEOUT, timeout_ms);
 }
 
 void QRCodeM14::setMotionSensitivity(int level)
 {
-    const uint8_t cmd[]     = {0x21, 0x61, 0x44, (uint8_t)level};
-    const uint8_t cmd_ack[] = {0x22, 0x61, 0x44, 0x00};
-    sendCmd(cmd, sizeof(cmd), cmd_ack, sizeof(cmd_ack), 200);
+    _set_register(REG_MOTION_SENSITIVITY, level);
 }
 
 void QRCodeM14::setContinuousDecodeDelay(int delay_ms)
 {
-    uint8_t high_byte       = (delay_ms >> 8) & 0xFF;
-    uint8_t low_byte        = delay_ms & 0xFF;
-    const uint8_t cmd[]     = {0x21, 0x61, 0x8C, high_byte, low_byte};
-    const uint8_t cmd_ack[] = {0x22, 0x61, 0x8C, 0x00, 0x00};
-    sendCmd(cmd, sizeof(cmd), cmd_ack, sizeof(cmd_ack), 200);
+    _set_register(REG_CONTINUOUS_DECODE_DELAY, delay_ms);
 }
 
 void QRCodeM14::setTriggerDecodeDelay(int delay_ms)
 {
-    uint8_t high_byte       = (delay_ms >> 8) & 0xFF;
-    uint8_t low_byte        = delay_ms & 0xFF;
-    const uint8_t cmd[]     = {0x21, 0x61, 0x85, high_byte, low_byte};
-    const uint8_t cmd_ack[] = {0x22, 0x61, 0x85, 0x00, 0x00};
-    sendCmd(cmd, sizeof(cmd), cmd_ack, sizeof(cmd_ack), 200);
+    _set_register(REG_TRIGGER_DECODE_DELAY, delay_ms);
 }
 
 void QRCodeM14::setSameCodeInterval(int interval_ms)
 {
-    uint8_t high_byte       = (interval_ms >> 8) & 0xFF;
-    uint8_t low_byte        = interval_ms & 0xFF;
-    const uint8_t cmd[]     = {0x21, 0x64, 0x82, high_byte, low_byte};
-    const uint8_t cmd_ack[] = {0x22, 0x64, 0x82, 0x00, 0x00};
-    sendCmd(cmd, sizeof(cmd), cmd_ack, sizeof(cmd_ack), 200);
+    _set_register(REG_SAME_CODE_INTERVAL, interval_ms);
 }
 
 void QRCodeM14::setDiffCodeInterval(int interval_ms)
 {
-    uint8_t high_byte       = (interval_ms >> 8) & 0xFF;
-    uint8_t low_byte        = interval_ms & 0xFF;
-    const uint8_t cmd[]     = {0x21, 0x64, 0x81, high_byte, low_byte};
-    const uint8_t cmd_ack[] = {0x22, 0x64, 0x81, 0x00, 0x00};
-    sendCmd(cmd, sizeof(cmd), cmd_ack, sizeof(cmd_ack), 200);
+    _set_register(REG_DIFF_CODE_INTERVAL, interval_ms);
 }
 
 void QRCodeM14::setSameCodeNoDelay(bool enable)
 {
-    uint8_t mode            = enable ? 0x01 : 0x00;
-    const uint8_t cmd[]     = {0x21, 0x64, 0x43, mode};
-    const uint8_t cmd_ack[] = {0x22, 0x64, 0x43, mode, 0x00};
-    sendCmd(cmd, sizeof(cmd), cmd_ack, sizeof(cmd_ack), 200);
+    _set_register(REG_SAME_CODE_NO_DELAY, enable ? 0x01 : 0x00);
 }
 
 void QRCodeM14::setFillLightMode(FillLightMode_t mode)
 {
-    const uint8_t cmd[]     = {0x21, 0x62, 0x41, (uint8_t)mode};
-    const uint8_t cmd_ack[] = {0x22, 0x62, 0x41, (uint8_t)mode, 0x00};
-    sendCmd(cmd, sizeof(cmd), cmd_ack, sizeof(cmd_ack), 200);
+    _set_register(REG_FILL_LIGHT_MODE, (uint8_t)mode);
 }
 
 void QRCodeM14::setFillLightBrightness(int brightness)
 {
-    brightness              = max(0, min(100, brightness));
-    const uint8_t cmd[]     = {0x21, 0x62, 0x48, (uint8_t)brightness};
-    const uint8_t cmd_ack[] = {0x22, 0x62, 0x48, (uint8_t)brightness, 0x00};
-    sendCmd(cmd, sizeof(cmd), cmd_ack, sizeof(cmd_ack), 100);
+    brightness = max(0, min(100, brightness));
+    _set_register(REG_FILL_LIGHT_BRIGHTNESS, brightness);
 }
 
 void QRCodeM14::setPosLightMode(PosLightMode_t mode)
 {
-    const uint8_t cmd[]     = {0x21, 0x62, 0x42, (uint8_t)mode};
-    const uint8_t cmd_ack[] = {0x22, 0x62, 0x42, (uint8_t)mode, 0x00};
-    sendCmd(cmd, sizeof(cmd), cmd_ack, sizeof(cmd_ack), 100);
+    _set_register(REG_POS_LIGHT_MODE, (uint8_t)mode);
 }
 
 void QRCodeM14::setStartupTone(int mode)
 {
-    const uint8_t cmd[]     = {0x21, 0x63, 0x45, (uint8_t)mode};
-    const uint8_t cmd_ack[] = {0x22, 0x63, 0x45, (uint8_t)mode};
-    sendCmd(cmd, sizeof(cmd), cmd_ack, sizeof(cmd_ack), 150);
+    _set_register(REG_STARTUP_TONE, mode);
 }
 
 void QRCodeM14::setDecodeSuccessBeep(int count)
 {
-    const uint8_t cmd[]     = {0x21, 0x63, 0x42, (uint8_t)count};
-    const uint8_t cmd_ack[] = {0x22, 0x63, 0x42, (uint8_t)count};
-    sendCmd(cmd, sizeof(cmd), cmd_ack, sizeof(cmd_ack), 150);
+    _set_register(REG_DECODE_SUCCESS_BEEP, count);
 }
 
 void QRCodeM14::setCaseConversion(int mode)
 {
-    const uint8_t cmd[]     = {0x21, 0x51, 0x48, (uint8_t)mode};
-    const uint8_t cmd_ack[] = {0x22, 0x51, 0x48, 0x00};
-    sendCmd(cmd, sizeof(cmd), cmd_ack, sizeof(cmd_ack), 200);
+    _set_register(REG_CASE_CONVERSION, mode);
 }
 
 void QRCodeM14::setProtocolFormat(int mode)
 {
-    const uint8_t cmd[]     = {0x21, 0x51, 0x43, (uint8_t)mode};
-    const uint8_t cmd_ack[] = {0x22, 0x51, 0x43, 0x00};
-    sendCmd(cmd, sizeof(cmd), cmd_ack, sizeof(cmd_ack), 200);
+    _set_register(REG_PROTOCOL_FORMAT, mode);
 }
 
 void QRCodeM14::setModeUsbSerial()
 {
-    const uint8_t cmd[] = {0x21, 0x42, 0x40, 0x02};
-    sendCmd(cmd, sizeof(cmd));
+    _set_register(REG_USB_MODE, 0x02);
 }
 
 void QRCodeM14::setModeUsbKeyboard()
 {
-    const uint8_t cmd[] = {0x21, 0x42, 0x40, 0x01};
-    sendCmd(cmd, sizeof(cmd));
+    _set_register(REG_USB_MODE, 0x01);
 }
 
 void QRCodeM14::setModeUsbPos()
 {
-    const uint8_t cmd[] = {0x21, 0x42, 0x40, 0x03};
-    sendCmd(cmd, sizeof(cmd));
+    _set_register(REG_USB_MODE, 0x03);
 }
 
-std::string QRCodeM14::getInfos(uint8_t id)
+size_t QRCodeM14::getInfos(uint8_t id, char* data, size_t data_size)
 {
+    if (!data || data_size == 0) {
+        return 0;
+    }
+    data[0] = '\0';
+
     const uint8_t cmd[] = {0x43, 0x02, id};
-    std::vector<uint8_t> response;
+    uint8_t response[QRCodeFrameScanner::HEADER_SIZE + MODULE_QRCODE_INFO_MAX_SIZE];
+    size_t len = 0;
+    QRCodeFrameScanner::Frame_t frame;
 
     sendCmd(cmd, sizeof(cmd));
     delay(10);
-    waitResponse(response);
 
-    uint16_t data_size = checkResponseDataSize(response);
-    if (data_size == 0) {
-        return "";
+    // Accumulate rx data until a valid response is found, dropping anything before a candidate header
+    uint32_t start_time = millis();
+    while (millis() - start_time < 1000) {
+        len += waitResponse(response + len, sizeof(response) - len, 0);
+
+        auto status = QRCodeFrameScanner::findResponse(response, len, cmd, MODULE_QRCODE_INFO_MAX_SIZE, frame);
+        if (status == QRCodeFrameScanner::FRAME_FOUND) {
+            size_t copy_size = min(frame.payload_len, data_size - 1);
+            memcpy(data, frame.payload, copy_size);
+            data[copy_size] = '\0';
+            return copy_size;
+        }
+
+        size_t drop = status == QRCodeFrameScanner::FRAME_PARTIAL ? frame.offset : len;
+        if (drop > 0) {
+            if (drop < len) {
+                _LOG_DEBUG("drop %d bytes before response\n", drop);
+            }
+            memmove(response, response + drop, len - drop);
+            len -= drop;
+        }
     }
 
-    std::string data(response.begin() + 5, response.begin() + 5 + data_size);
+    _LOG_ERROR("no valid response for info 0x%02x\n", id);
+    return 0;
+}
 
-    return data;
+#if !MODULE_QRCODE_STATIC_ALLOC
+std::string QRCodeM14::getInfos(uint8_t id)
+{
+    char data[MODULE_QRCODE_INFO_MAX_SIZE + 1];
+    size_t len = getInfos(id, data, sizeof(data));
+    return std::string(data, len);
+}
+
+std::vector<uint8_t> QRCodeM14::exportConfig()
+{
+    uint8_t blob[CONFIG_BLOB_MAX_SIZE];
+    size_t len = exportConfig(blob, sizeof(blob));
+    return std::vector<uint8_t>(blob, blob + len);
 }
+#endif
@@ -5,13 +5,52 @@
  */
 #pragma once
 #include <Arduino.h>
+
+/**
+ * @brief Heap-free build profile.
+ * Set to 1 (e.g. -DMODULE_QRCODE_STATIC_ALLOC=1) to compile out every API that allocates (std::string / std::vector /
+ * std::function). Only the caller-buffer variants and static storage are used then.
+ */
+#ifndef MODULE_QRCODE_STATIC_ALLOC
+#define MODULE_QRCODE_STATIC_ALLOC 0
+#endif
+
+/**
+ * @brief Count global operator new calls, see QRCodeM14::getAllocCount().
+ * Replaces the global allocation functions, so enable it only in builds used to verify memory behaviour.
+ */
+#ifndef MODULE_QRCODE_COUNT_ALLOC
+#define MODULE_QRCODE_COUNT_ALLOC 0
+#endif
+
+/**
+ * @brief Size of the static scan result buffer used by the heap-free profile.
+ */
+#ifndef MODULE_QRCODE_RX_BUFFER_SIZE
+#define MODULE_QRCODE_RX_BUFFER_SIZE 1024
+#endif
+
+/**
+ * @brief Max payload size of a device information response.
+ */
+#ifndef MODULE_QRCODE_INFO_MAX_SIZE
+#define MODULE_QRCODE_INFO_MAX_SIZE 64
+#endif
+
+#if !MODULE_QRCODE_STATIC_ALLOC
 #include <string>
 #include <vector>
+#endif
 
 class QRCodeM14 {
 public:
     enum CmdResult_t { SUCCESS = 0, INVALID_PARAM = 1, TIMEOUT = 2, ACK_MISMATCH = 3 };
 
+    /**
+     * @brief Upper bound of an exportConfig() blob.
+     */
+    static constexpr size_t CONFIG_BLOB_MAX_SIZE = 32;
+
     enum TriggerMode_t {
         TRIGGER_MODE_KEY = 0,  // In Key Mode, Triggers a single decode; decoding stops after a successful read.
         TRIGGER_MODE_CONTINUOUS =
@@ -159,6 +198,60 @@ public:
      */
     void setModeUsbPos();
 
+    /**
+     * @brief Get device information by ID.
+     * @param id Information ID
+     * @param data Output buffer, always null terminated
+     * @param data_size Output buffer size
+     * @return Information length, 0 on failure
+     */
+    size_t getInfos(uint8_t id, char* data, size_t data_size);
+
+    /**
+     * @brief Get software version.
+     * @param data Output buffer, always null terminated
+     * @param data_size Output buffer size
+     * @return Version string length, 0 on failure
+     */
+    inline size_t getSoftwareVersion(char* data, size_t data_size)
+    {
+        return getInfos(0xC2, data, data_size);
+    }
+
+    /**
+     * @brief Get firmware version.
+     * @param data Output buffer, always null terminated
+     * @param data_size Output buffer size
+     * @return Version string length, 0 on failure
+     */
+    inline size_t getFirmwareVersion(char* data, size_t data_size)
+    {
+        return getInfos(0xC1, data, data_size);
+    }
+
+    /**
+     * @brief Export the settings applied through this driver as a versioned, checksummed blob.
+     * The module has no command to read its settings back, so only setter calls acknowledged by the module (or
+     * imported) are included; call the setters once after begin() for a complete snapshot. Temporary writes of the
+     * power scheduler (lights) and the auto tuner (decode intervals) are not part of the snapshot.
+     * @param blob Output buffer, CONFIG_BLOB_MAX_SIZE bytes is always enough
+     * @param blob_size Output buffer size
+     * @return Blob length, 0 if the buffer is too small
+     */
+    size_t exportConfig(uint8_t* blob, size_t blob_size);
+
+    /**
+     * @brief Apply a blob from exportConfig(). The blob is validated before anything is written, registers known to
+     * hold the value already are skipped and the others are written back to back, each ack is checked.
+     * What the module holds is forgotten on begin() and power off, so a swapped module is always written in full.
+     * @param blob Config blob
+     * @param len Blob length
+     * @param force Write every register of the blob, e.g. after replacing the module without begin()
+     * @return INVALID_PARAM for a malformed blob, otherwise SUCCESS or the last register write error
+     */
+    CmdResult_t importConfig(const uint8_t* blob, size_t len, bool force = false);
+
+#if !MODULE_QRCODE_STATIC_ALLOC
     /**
      * @brief Get device information by ID.
      * @param id Information ID
@@ -183,6 +276,7 @@ public:
     {
         return getInfos(0xC1);
     }
+#endif
 
     /**
      * @brief Check if serial data is available.
@@ -205,12 +299,126 @@ public:
     CmdResult_t sendCmd(const uint8_t* cmd, size_t cmd_len, const uint8_t* cmd_ack = nullptr, size_t ack_len = 0,
                         uint32_t timeout_ms = 1000);
 
+    /**
+     * @brief Send command to QR code module (array version).
+     * @param cmd Command data array
+     * @return Command execution result
+     */
+    template <size_t N>
+    inline CmdResult_t sendCmd(const uint8_t (&cmd)[N])
+    {
+        return sendCmd(cmd, N);
+    }
+
+    /**
+     * @brief Wait for response from QR code module.
+     * @param response Response data buffer
+     * @param response_size Response data buffer size
+     * @param timeout_ms Timeout in milliseconds (default: 1000)
+     * @return Number of bytes received
+     */
+    size_t waitResponse(uint8_t* response, size_t response_size, uint32_t timeout_ms = 1000);
+
+    /**
+     * @brief Get response data size from a validated header.
+     * @param response Response data buffer, starting with the header
+     * @param len Response data length
+     * @param cmd Command the response answers, at least 3 bytes
+     * @return Data size, 0 if the buffer does not start with a valid header for cmd
+     */
+    uint16_t getResponseDataSize(const uint8_t* response, size_t len, const uint8_t* cmd);
+
+    /**
+     * @brief Check that a complete, valid response for cmd starts the buffer.
+     * @param response Response data buffer
+     * @param len Response data length
+     * @param cmd Command the response answers, at least 3 bytes
+     * @return Data size, 0 if the header is invalid or the data is incomplete
+     */
+    uint16_t checkResponseDataSize(const uint8_t* response, size_t len, const uint8_t* cmd);
+
+    /**
+     * @brief Get response data size.
+     * @param response Response data buffer
+     * @param len Response data length
+     * @return Data size
+     * @deprecated Reads the header at a fixed offset without validating the opcode, stray scan data can be taken for
+     * a response. Use the overload taking the command.
+     */
+    [[deprecated("use getResponseDataSize(response, len, cmd)")]] uint16_t getResponseDataSize(const uint8_t* response,
+                                                                                                size_t len);
+
+    /**
+     * @brief Check response data size.
+     * @param response Response data buffer
+     * @param len Response data length
+     * @return Data size
+     * @deprecated Same as getResponseDataSize(response, len). Use the overload taking the command.
+     */
+    [[deprecated("use checkResponseDataSize(response, len, cmd)")]] uint16_t checkResponseDataSize(
+        const uint8_t* response, size_t len);
+
+    /**
+     * @brief Wait for QR code scan result.
+     * @param result Scan result buffer, always null terminated
+     * @param result_size Scan result buffer size
+     * @param timeout_ms Timeout in milliseconds (default: infinite)
+     * @return Scan result length
+     */
+    size_t waitScanResult(char* result, size_t result_size, uint32_t timeout_ms = 0xFFFFFFFF);
+
+    /**
+     * @brief Convert command result to string.
+     * @param result Command result enum
+     * @return Result description string (static storage)
+     */
+    static const char* cmdResultToCStr(CmdResult_t result);
+
+    /**
+     * @brief Get the number of global operator new calls since boot.
+     * @return Allocation count, always 0 unless MODULE_QRCODE_COUNT_ALLOC is enabled
+     */
+    static uint32_t getAllocCount();
+
+    /**
+     * @brief Print pending log records, see MODULE_QRCODE_LOG_LEVEL. Without the log task, M5ModuleQRCode::update()
+     * prints up to MODULE_QRCODE_LOG_DRAIN_PER_UPDATE records per call; call it from loop() when only the QRCodeM14 or
+     * coroutine API is used. Safe to call while the log task runs.
+     * @param max_records Max number of records to print (default: all)
+     * @return Number of records printed
+     */
+    static size_t drainLog(size_t max_records = SIZE_MAX);
+
+    /**
+     * @brief Get the number of log records dropped because the log ring was full.
+     * @return Dropped record count
+     */
+    static uint32_t getLogDropCount();
+
+#if defined(ESP_PLATFORM)
+    /**
+     * @brief Start a background task that drains the log ring periodically, M5ModuleQRCode::update() then stops
+     * printing log records.
+     * @param priority Task priority (default: just above idle)
+     * @param interval_ms Drain interval in milliseconds (default: 50)
+     * @return true if the task runs
+     */
+    static bool startLogTask(UBaseType_t priority = tskIDLE_PRIORITY + 1, uint32_t interval_ms = 50);
+#endif
+
+    /**
+     * @brief Check if the log task drains the log ring.
+     * @return true once startLogTask() succeeded
+     */
+    static bool isLogTaskRunning();
+
+#if !MODULE_QRCODE_STATIC_ALLOC
     /**
      * @brief Send command to QR code module (vector version).
      * @param cmd Command data vector
      * @return Command execution result
      */
-    inline CmdResult_t sendCmd(std::vector<uint8_t> cmd)
+    inline CmdResult_t sendCmd(const std::vector<uint8_t>& cmd)
     {
         return sendCmd(cmd.data(), cmd.size());
     }
@@ -222,19 +430,45 @@ public:
      */
     void waitResponse(std::vector<uint8_t>& response, uint32_t timeout_ms = 1000);
 
+    /**
+     * @brief Get response data size from a validated header.
+     * @param response Response data buffer
+     * @param cmd Command the response answers, at least 3 bytes
+     * @return Data size
+     */
+    inline uint16_t getResponseDataSize(const std::vector<uint8_t>& response, const uint8_t* cmd)
+    {
+        return getResponseDataSize(response.data(), response.size(), cmd);
+    }
+
+    /**
+     * @brief Check that a complete, valid response for cmd starts the buffer.
+     * @param response Response data buffer
+     * @param cmd Command the response answers, at least 3 bytes
+     * @return Data size
+     */
+    inline uint16_t checkResponseDataSize(const std::vector<uint8_t>& response, const uint8_t* cmd)
+    {
+        return checkResponseDataSize(response.data(), response.size(), cmd);
+    }
+
     /**
      * @brief Get response data size.
      * @param response Response data buffer
      * @return Data size
+     * @deprecated Does not validate the header, use the overload taking the command.
      */
-    uint16_t getResponseDataSize(std::vector<uint8_t>& response);
+    [[deprecated("use getResponseDataSize(response, cmd)")]] uint16_t getResponseDataSize(
+        std::vector<uint8_t>& response);
 
     /**
      * @brief Check response data size.
      * @param response Response data buffer
      * @return Data size
+     * @deprecated Does not validate the header, use the overload taking the command.
      */
-    uint16_t checkResponseDataSize(std::vector<uint8_t>& response);
+    [[deprecated("use checkResponseDataSize(response, cmd)")]] uint16_t checkResponseDataSize(
+        std::vector<uint8_t>& response);
 
     /**
      * @brief Wait for QR code scan result.
@@ -248,11 +482,105 @@ public:
      * @param result Command result enum
      * @return Result description string
      */
-    std::string cmdResultToString(CmdResult_t result);
+    inline std::string cmdResultToString(CmdResult_t result)
+    {
+        return cmdResultToCStr(result);
+    }
+
+    /**
+     * @brief Export the applied settings (vector version).
+     * @return Config blob
+     */
+    std::vector<uint8_t> exportConfig();
+
+    /**
+     * @brief Apply a config blob (vector version).
+     * @param blob Config blob
+     * @return Command execution result
+     */
+    inline CmdResult_t importConfig(const std::vector<uint8_t>& blob, bool force = false)
+    {
+        return importConfig(blob.data(), blob.size(), force);
+    }
+#endif
 
 protected:
     HardwareSerial* _qrcode_serial = nullptr;
 
+    /**
+     * @brief Clear rx buffer and write command, without waiting for the ack.
+     * @return false on invalid param
+     */
+    bool _write_cmd(const uint8_t* cmd, size_t cmd_len);
+
+    // Ack parser state, reset by _write_cmd()
+    size_t _ack_pos = 0;
+    bool _ack_match = true;
+
+    /**
+     * @brief Read and compare ack if it has fully arrived, skipping rx data before the ack header.
+     * @return TIMEOUT while the ack is still incomplete, otherwise SUCCESS or ACK_MISMATCH
+     */
+    CmdResult_t _check_ack(const uint8_t* cmd_ack, size_t ack_len);
+
+    enum Register_t {
+        REG_TRIGGER_MODE = 0,
+        REG_DECODE_DELAY,
+        REG_TRIGGER_TIMEOUT,
+        REG_MOTION_SENSITIVITY,
+        REG_CONTINUOUS_DECODE_DELAY,
+        REG_TRIGGER_DECODE_DELAY,
+        REG_SAME_CODE_INTERVAL,
+        REG_DIFF_CODE_INTERVAL,
+        REG_SAME_CODE_NO_DELAY,
+        REG_FILL_LIGHT_MODE,
+        REG_FILL_LIGHT_BRIGHTNESS,
+        REG_POS_LIGHT_MODE,
+        REG_STARTUP_TONE,
+        REG_DECODE_SUCCESS_BEEP,
+        REG_CASE_CONVERSION,
+        REG_PROTOCOL_FORMAT,
+        REG_USB_MODE,
+        REG_COUNT
+    };
+
+    // Last acknowledged configured value of each register, for exportConfig()
+    uint16_t _register_values[REG_COUNT] = {};
+    uint32_t _register_mask              = 0;
+    // Registers the module is known to hold the configured value of, importConfig() skips them
+    uint32_t _register_synced_mask = 0;
+
+    /**
+     * @brief Write a register and wait for the ack.
+     * @param persist false for temporary runtime writes (power scheduler, auto tuner), which leave the configured value
+     * in the snapshot
+     * @return Command execution result
+     */
+    CmdResult_t _set_register(Register_t reg, uint16_t value, bool persist = true);
+
+    /**
+     * @brief Write a register and poll for the ack, without the fixed 100 ms delay of sendCmd().
+     * @param persist See _set_register()
+     * @return Command execution result
+     */
+    CmdResult_t _write_register(Register_t reg, uint16_t value, bool persist = true);
+
+    size_t _build_register_cmd(Register_t reg, uint16_t value, uint8_t* cmd, uint8_t* cmd_ack, size_t* ack_len);
+    void _remember_register(Register_t reg, uint16_t value, CmdResult_t result);
+
+    /**
+     * @brief Forget which registers the module holds, e.g. after a power cycle. Exported values are kept.
+     */
+    inline void _invalidate_registers()
+    {
+        _register_synced_mask = 0;
+    }
+
+    friend class QRCodeAsync;
+    friend class QRCodeAutoTuner;
+    friend class QRCodePowerScheduler;
+    friend class QRCodeRequestTracker;
+
     void _setup(HardwareSerial* serial)
     {
         _qrcode_serial = serial;
@@ -0,0 +1,286 @@
+/*
+ * SPDX-FileCopyrightText: 2025 M5Stack Technology CO LTD
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "qrcode_power.h"
+#include "debug.h"
+
+void QRCodePowerScheduler::begin()
+{
+    uint32_t now = millis();
+
+    _epoch_ms                 = now;
+    _last_tick_ms             = now;
+    _stats                    = Stats_t();
+    _stats.warmup_estimate_ms = _config.initial_warmup_ms;
+
+    _module.setEnable(false);
+    _lights_on     = false;
+    _lights_known  = false;
+    _lights_wanted = false;
+    _in_window     = false;
+    _set_state(STATE_OFF);
+
+    update();
+}
+
+void QRCodePowerScheduler::onScan()
+{
+    _last_scan_ms = millis();
+}
+
+void QRCodePowerScheduler::onActivity()
+{
+    _last_scan_ms  = millis();
+    _lights_wanted = true;
+}
+
+void QRCodePowerScheduler::wake(uint32_t duration_ms)
+{
+    _wake_active   = true;
+    _wake_end_ms   = millis() + duration_ms;
+    _last_scan_ms  = millis();
+    _lights_wanted = true;
+
+    update();
+}
+
+bool QRCodePowerScheduler::scheduleWake(uint32_t start_ms, uint32_t duration_ms)
+{
+    if (_window_count >= MODULE_QRCODE_POWER_MAX_WINDOWS) {
+        return false;
+    }
+
+    _windows[_window_count].start_ms = start_ms;
+    _windows[_window_count].end_ms   = start_ms + duration_ms;
+    _window_count++;
+    return true;
+}
+
+uint32_t QRCodePowerScheduler::_time_to_window(uint32_t now) const
+{
+    uint32_t time_to = 0xFFFFFFFF;
+
+    if (_wake_active) {
+        return 0;
+    }
+
+    if (_config.period_ms > 0 && _config.window_ms > 0) {
+        uint32_t phase = (now - _epoch_ms) % _config.period_ms;
+        time_to        = phase < _config.window_ms ? 0 : _config.period_ms - phase;
+    }
+
+    for (size_t i = 0; i < _window_count; i++) {
+        int32_t to_start = (int32_t)(_windows[i].start_ms - now);
+        time_to          = min(time_to, to_start > 0 ? (uint32_t)to_start : 0);
+    }
+
+    return time_to;
+}
+
+void QRCodePowerScheduler::update()
+{
+    uint32_t now = millis();
+    _account(now);
+
+    // Drop expired windows
+    if (_wake_active && (int32_t)(now - _wake_end_ms) >= 0) {
+        _wake_active = false;
+    }
+    for (size_t i = 0; i < _window_count;) {
+        if ((int32_t)(now - _windows[i].end_ms) >= 0) {
+            _windows[i] = _windows[--_window_count];
+        } else {
+            i++;
+        }
+    }
+
+    uint32_t time_to_window = _time_to_window(now);
+    bool in_window          = time_to_window == 0;
+    bool need_power         = time_to_window <= _stats.warmup_estimate_ms + _config.prewake_margin_ms;
+
+    // Window start, e.g. the next periodic window while the module stays powered
+    if (in_window && !_in_window) {
+        _last_scan_ms  = now;
+        _lights_wanted = true;
+    }
+    _in_window = in_window;
+
+    switch (_state) {
+        case STATE_OFF:
+            if (need_power) {
+                _LOG_DEBUG("power on, window in %d ms\n", time_to_window);
+                _module.setEnable(true);
+                _power_on_ms   = now;
+                _next_probe_ms = now;
+                _probe_len     = 0;
+                _answered      = false;
+                _late_wake     = false;
+                _lights_known  = false;
+                _next_light_ms = now;
+                _stats.wake_count++;
+                _set_state(STATE_WARMING);
+            }
+            break;
+
+        case STATE_WARMING: {
+            if (!need_power) {
+                _module.setEnable(false);
+                _set_state(STATE_OFF);
+                break;
+            }
+            if (in_window) {
+                _late_wake = true;
+            }
+
+            uint32_t elapsed = now - _power_on_ms;
+            bool answered    = _poll_probe(now);
+            if (answered) {
+                // Set the lights now rather than when the first scan is expected, the time counts as warm-up
+                _lights_wanted = true;
+                _apply_lights(now);
+                now     = millis();
+                elapsed = now - _power_on_ms;
+                _account(now);
+
+                _stats.last_warmup_ms     = elapsed;
+                _stats.warmup_estimate_ms = (_stats.warmup_estimate_ms * 3 + elapsed) / 4;
+                _LOG_DEBUG("warm-up %d ms, estimate %d ms\n", elapsed, _stats.warmup_estimate_ms);
+            } else if (elapsed < _config.max_warmup_ms) {
+                break;
+            }
+
+            if (_late_wake) {
+                _stats.late_wake_count++;
+            }
+            _set_state(STATE_ACTIVE);
+            _last_scan_ms  = now;
+            _lights_wanted = true;
+            break;
+        }
+
+        case STATE_ACTIVE:
+            if (!need_power) {
+                _module.setEnable(false);
+                _lights_on = false;
+                _set_state(STATE_OFF);
+                break;
+            }
+            if (_lights_wanted && _config.light_idle_ms > 0 && now - _last_scan_ms >= _config.light_idle_ms) {
+                _lights_wanted = false;
+            }
+            _apply_lights(now);
+            break;
+
+        default:
+            break;
+    }
+}
+
+void QRCodePowerScheduler::_account(uint32_t now)
+{
+    uint32_t elapsed = now - _last_tick_ms;
+    _last_tick_ms    = now;
+
+    switch (_state) {
+        case STATE_OFF:
+            _stats.off_ms += elapsed;
+            break;
+        case STATE_WARMING:
+            _stats.warming_ms += elapsed;
+            break;
+        case STATE_ACTIVE:
+            _stats.active_ms += elapsed;
+            break;
+        default:
+            break;
+    }
+
+    if (_lights_on) {
+        _stats.lights_on_ms += elapsed;
+    }
+}
+
+void QRCodePowerScheduler::_set_state(State_t state)
+{
+    _state = state;
+
+    if (_on_state_change) {
+        _on_state_change(state, _on_state_change_user_data);
+    }
+}
+
+bool QRCodePowerScheduler::_poll_probe(uint32_t now)
+{
+    static const uint8_t cmd[] = {0x43, 0x02, 0xC1};
+
+    // Collect the answer without blocking, waitResponse() returns at once when data is available
+    while (_module.QRCodeM14::available() > 0) {
+        if (_probe_len == sizeof(_probe_rx)) {
+            _probe_len = 0;
+        }
+        _probe_len += _module.waitResponse(_probe_rx + _probe_len, sizeof(_probe_rx) - _probe_len, 0);
+        _last_rx_ms = now;
+    }
+
+    if (!_answered) {
+        QRCodeFrameScanner::Frame_t frame;
+        QRCodeFrameScanner::Status_t status =
+            QRCodeFrameScanner::findResponse(_probe_rx, _probe_len, cmd, MODULE_QRCODE_INFO_MAX_SIZE, frame);
+        if (status == QRCodeFrameScanner::FRAME_FOUND) {
+            _answered = true;
+        } else if (status == QRCodeFrameScanner::FRAME_PARTIAL) {
+            // Keep the partial answer at the start of the buffer
+            memmove(_probe_rx, _probe_rx + frame.offset, _probe_len - frame.offset);
+            _probe_len -= frame.offset;
+        } else {
+            // Boot noise
+            _probe_len = 0;
+        }
+    }
+
+    if (!_answered) {
+        // Query again only while nothing is on the way, so at most one answer is pending at a time
+        if (_probe_len == 0 && (int32_t)(now - _next_probe_ms) >= 0) {
+            _module.sendCmd(cmd, sizeof(cmd));
+            _next_probe_ms = now + _config.probe_interval_ms;
+        }
+        return false;
+    }
+
+    // Wait until answers to earlier queries have arrived too, so none is taken as a scan result later
+    if (now - _last_rx_ms < _config.probe_interval_ms) {
+        return false;
+    }
+    _probe_len = 0;
+    return true;
+}
+
+bool QRCodePowerScheduler::_apply_lights(uint32_t now)
+{
+    if (_lights_known && _lights_on == _lights_wanted) {
+        return true;
+    }
+    // Light commands flush the rx buffer, wait until received scans have been read
+    if (_module.QRCodeM14::available() > 0 || (int32_t)(now - _next_light_ms) < 0) {
+        return false;
+    }
+
+    QRCodeM14::FillLightMode_t fill_mode = _lights_wanted ? _config.fill_light_mode : QRCodeM14::FILL_LIGHT_OFF;
+    QRCodeM14::PosLightMode_t pos_mode   = _lights_wanted ? _config.pos_light_mode : QRCodeM14::POS_LIGHT_OFF;
+
+    // Temporary writes, the configured light modes stay in the config snapshot
+    QRCodeM14& device = _module;
+    if (device._write_register(QRCodeM14::REG_FILL_LIGHT_MODE, fill_mode, false) != QRCodeM14::CmdResult_t::SUCCESS ||
+        device._write_register(QRCodeM14::REG_POS_LIGHT_MODE, pos_mode, false) != QRCodeM14::CmdResult_t::SUCCESS) {
+        _LOG_DEBUG("light command failed, retry in %d ms\n", _config.light_retry_ms);
+        _lights_known  = false;
+        _next_light_ms = now + _config.light_retry_ms;
+        return false;
+    }
+
+    _lights_on    = _lights_wanted;
+    _lights_known = true;
+    return true;
+}
@@ -0,0 +1,202 @@
+/*
+ * SPDX-FileCopyrightText: 2025 M5Stack Technology CO LTD
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include "M5ModuleQRCode.h"
+#include "qrcode_frame.h"
+
+/**
+ * @brief Max number of pending scheduled wake windows.
+ */
+#ifndef MODULE_QRCODE_POWER_MAX_WINDOWS
+#define MODULE_QRCODE_POWER_MAX_WINDOWS 4
+#endif
+
+/**
+ * @brief Duty-cycled power scheduler.
+ *
+ * Powers the module through the PI4IOE5V6408 only inside scan windows: a periodic window, scheduled windows and
+ * external wake events. The module warm-up time is measured on every power on (time until it answers a version query
+ * and the line stays quiet) and used to power it on ahead of scheduled windows, so the first scan is not delayed. Fill
+ * and position lights are switched off after a period without scans, and back on at the start of a window, on wake()
+ * or onActivity(). After power on they are set before the module is reported ready, as part of the warm-up. Light
+ * commands are only sent while no rx data is waiting, since they flush the rx buffer, and retried if not acknowledged.
+ *
+ * Attach it with M5ModuleQRCode::setPowerScheduler(), update() then runs it and ignores rx data while warming up.
+ */
+class QRCodePowerScheduler {
+public:
+    enum State_t {
+        STATE_OFF = 0,  // Module powered off
+        STATE_WARMING,  // Powered on, waiting for the module to answer
+        STATE_ACTIVE    // Ready to scan
+    };
+
+    struct Config_t {
+        uint32_t period_ms         = 0;     // Periodic window period, 0 to disable
+        uint32_t window_ms         = 0;     // Periodic window length
+        uint32_t prewake_margin_ms = 50;    // Extra time added to the warm-up estimate
+        uint32_t initial_warmup_ms = 300;   // Warm-up estimate before the first measurement
+        uint32_t probe_interval_ms = 50;    // Version query retry interval, also quiet time after the answer
+        uint32_t max_warmup_ms     = 3000;  // Consider the module ready after this long without answer
+        uint32_t light_idle_ms     = 2000;  // Lights off after this long without scans, 0 to keep them on
+        uint32_t light_retry_ms    = 1000;  // Light command retry interval, each failed try blocks and drops rx data
+
+        QRCodeM14::FillLightMode_t fill_light_mode = QRCodeM14::FILL_LIGHT_ON_DECODE;
+        QRCodeM14::PosLightMode_t pos_light_mode   = QRCodeM14::POS_LIGHT_ON_DECODE;
+    };
+
+    /**
+     * @brief Energy-relevant statistics, times in milliseconds.
+     */
+    struct Stats_t {
+        uint32_t off_ms             = 0;
+        uint32_t warming_ms         = 0;
+        uint32_t active_ms          = 0;
+        uint32_t lights_on_ms       = 0;
+        uint32_t wake_count         = 0;  // Power on count
+        uint32_t late_wake_count    = 0;  // Windows that started before the module was ready
+        uint32_t last_warmup_ms     = 0;
+        uint32_t warmup_estimate_ms = 0;
+
+        /**
+         * @brief Fraction of time the module was powered.
+         */
+        inline float dutyCycle() const
+        {
+            uint32_t total = off_ms + warming_ms + active_ms;
+            return total > 0 ? (float)(warming_ms + active_ms) / total : 0.0f;
+        }
+    };
+
+    typedef void (*StateCallback_t)(State_t state, void* user_data);
+
+    explicit QRCodePowerScheduler(M5ModuleQRCode& module) : _module(module)
+    {
+    }
+
+    Config_t getConfig() const
+    {
+        return _config;
+    }
+    void setConfig(const Config_t& config)
+    {
+        _config = config;
+    }
+
+    /**
+     * @brief Start scheduling, the periodic window phase starts now.
+     */
+    void begin();
+
+    /**
+     * @brief Run the scheduler.
+     */
+    void update();
+
+    /**
+     * @brief Report scan activity, restarts the light idle time.
+     */
+    void onScan();
+
+    /**
+     * @brief External activity event (e.g. a presence sensor), switches the lights back on.
+     */
+    void onActivity();
+
+    /**
+     * @brief External wake event, powers the module on now and switches the lights back on.
+     * @param duration_ms Time to keep the module active
+     */
+    void wake(uint32_t duration_ms);
+
+    /**
+     * @brief Schedule a wake window, the module is powered on ahead of it.
+     * @param start_ms Window start, millis() time base
+     * @param duration_ms Window length
+     * @return false if too many windows are pending
+     */
+    bool scheduleWake(uint32_t start_ms, uint32_t duration_ms);
+
+    inline State_t getState() const
+    {
+        return _state;
+    }
+
+    /**
+     * @brief Check if the module is powered and ready to scan.
+     */
+    inline bool isReady() const
+    {
+        return _state == STATE_ACTIVE;
+    }
+
+    inline Stats_t getStats() const
+    {
+        return _stats;
+    }
+
+    inline void resetStats()
+    {
+        uint32_t estimate         = _stats.warmup_estimate_ms;
+        _stats                    = Stats_t();
+        _stats.warmup_estimate_ms = estimate;
+    }
+
+    /**
+     * @brief Set on state change callback, e.g. to reapply settings after power on.
+     *
+     * @param callback
+     * @param user_data
+     */
+    inline void onStateChange(StateCallback_t callback, void* user_data = nullptr)
+    {
+        _on_state_change           = callback;
+        _on_state_change_user_data = user_data;
+    }
+
+private:
+    struct Window_t {
+        uint32_t start_ms;
+        uint32_t end_ms;
+    };
+
+    M5ModuleQRCode& _module;
+    Config_t _config;
+    Stats_t _stats;
+    State_t _state = STATE_OFF;
+
+    uint32_t _epoch_ms      = 0;
+    uint32_t _last_tick_ms  = 0;
+    uint32_t _power_on_ms   = 0;
+    uint32_t _next_probe_ms = 0;
+    uint32_t _last_scan_ms  = 0;
+    uint32_t _next_light_ms = 0;
+    bool _lights_on         = false;  // Last acknowledged light state
+    bool _lights_known      = false;  // false after power on or a failed light command
+    bool _lights_wanted     = false;
+    bool _late_wake         = false;
+    bool _in_window         = false;
+
+    // Version query answer while warming up
+    uint8_t _probe_rx[QRCodeFrameScanner::HEADER_SIZE + MODULE_QRCODE_INFO_MAX_SIZE];
+    size_t _probe_len    = 0;
+    bool _answered       = false;
+    uint32_t _last_rx_ms = 0;
+
+    bool _wake_active     = false;
+    uint32_t _wake_end_ms = 0;
+    Window_t _windows[MODULE_QRCODE_POWER_MAX_WINDOWS];
+    size_t _window_count = 0;
+
+    StateCallback_t _on_state_change = nullptr;
+    void* _on_state_change_user_data = nullptr;
+
+    uint32_t _time_to_window(uint32_t now) const;
+    void _account(uint32_t now);
+    void _set_state(State_t state);
+    bool _poll_probe(uint32_t now);
+    bool _apply_lights(uint32_t now);
+};
@@ -0,0 +1,179 @@
+/*
+ * SPDX-FileCopyrightText: 2025 M5Stack Technology CO LTD
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "qrcode_request.h"
+#include "debug.h"
+
+bool QRCodeRequestTracker::trigger(QRCodeScanRequest& request, uint32_t timeout_ms)
+{
+    if (request.state == QRCodeScanRequest::STATE_PENDING) {
+        return false;
+    }
+
+    if (timeout_ms > 0xFFFF) {
+        return false;
+    }
+
+    // Written again after a power cycle or a failed write, see QRCodeM14::_invalidate_registers()
+    QRCodeM14& device = _module;
+    bool synced = device._register_synced_mask & (1UL << QRCodeM14::REG_TRIGGER_TIMEOUT);
+    if (!synced || device._register_values[QRCodeM14::REG_TRIGGER_TIMEOUT] != timeout_ms) {
+        // The write would flush results of requests in flight
+        if (_head != nullptr) {
+            _LOG_DEBUG("trigger timeout change refused, %d requests pending\n", pending());
+            return false;
+        }
+        QRCodeM14::CmdResult_t result = device._set_register(QRCodeM14::REG_TRIGGER_TIMEOUT, timeout_ms);
+        if (result != QRCodeM14::CmdResult_t::SUCCESS) {
+            _LOG_ERROR("trigger timeout write failed: %d\n", result);
+            return false;
+        }
+    }
+
+    // Trigger a scan
+    _module.setTriggerLevel(false);
+    delay(_config.pulse_ms);
+    _module.setTriggerLevel(true);
+
+    uint32_t now               = millis();
+    request.id                 = _next_id++;
+    request.state              = QRCodeScanRequest::STATE_PENDING;
+    request.trigger_ms         = now;
+    request.trigger_timeout_ms = timeout_ms;
+    request.deadline_ms        = now + timeout_ms + _config.result_margin_ms;
+    request.complete_ms        = 0;
+    request.result_len         = 0;
+    request._next              = nullptr;
+    if (request.result && request.result_size > 0) {
+        request.result[0] = '\0';
+    }
+
+    if (_tail) {
+        _tail->_next = &request;
+    } else {
+        _head = &request;
+    }
+    _tail = &request;
+
+    _stats.triggers++;
+    _LOG_DEBUG("request %d triggered, timeout %d ms\n", request.id, timeout_ms);
+
+    return true;
+}
+
+void QRCodeRequestTracker::cancel(QRCodeScanRequest& request)
+{
+    if (_unlink(request)) {
+        request.state = QRCodeScanRequest::STATE_IDLE;
+    }
+}
+
+void QRCodeRequestTracker::onScan(const char* data, size_t len)
+{
+    uint32_t now = millis();
+    _expire(now);
+
+    // Most recently expired request, if the result is not too late for it
+    uint32_t late_id = 0;
+    if (_expired_total > 0) {
+        const Expired_t& expired = _expired[(_expired_total - 1) % MODULE_QRCODE_REQUEST_LATE_HISTORY];
+        if (now - expired.deadline_ms <= _config.late_window_ms) {
+            late_id = expired.id;
+        }
+    }
+
+    // Oldest pending request owns the result, unless it was triggered too recently to have decoded anything
+    if (_head && (late_id == 0 || now - _head->trigger_ms >= _config.min_decode_ms)) {
+        QRCodeScanRequest& request = *_head;
+        request.result_len         = len;
+        if (request.result && request.result_size > 0) {
+            size_t copy_size = min(len, request.result_size - 1);
+            memcpy(request.result, data, copy_size);
+            request.result[copy_size] = '\0';
+        }
+        _complete(request, QRCodeScanRequest::STATE_RESULT, now);
+        return;
+    }
+
+    if (late_id != 0) {
+        _stats.late++;
+        _LOG_DEBUG("late result for request %d\n", late_id);
+    } else {
+        _stats.unsolicited++;
+    }
+
+    if (_on_late) {
+        _on_late(late_id, data, len, _on_late_user_data);
+    }
+}
+
+void QRCodeRequestTracker::update()
+{
+    _expire(millis());
+}
+
+size_t QRCodeRequestTracker::pending() const
+{
+    size_t count = 0;
+    for (QRCodeScanRequest* it = _head; it != nullptr; it = it->_next) {
+        count++;
+    }
+    return count;
+}
+
+void QRCodeRequestTracker::_expire(uint32_t now)
+{
+    // Requests are queued in trigger order, but timeouts may differ, so check all of them
+    QRCodeScanRequest* it = _head;
+    while (it != nullptr) {
+        QRCodeScanRequest* next = it->_next;
+        if ((int32_t)(now - it->deadline_ms) > 0) {
+            Expired_t& expired  = _expired[_expired_total % MODULE_QRCODE_REQUEST_LATE_HISTORY];
+            expired.id          = it->id;
+            expired.deadline_ms = it->deadline_ms;
+            _expired_total++;
+            _complete(*it, QRCodeScanRequest::STATE_NO_READ, now);
+        }
+        it = next;
+    }
+}
+
+void QRCodeRequestTracker::_complete(QRCodeScanRequest& request, QRCodeScanRequest::State_t state, uint32_t now)
+{
+    _unlink(request);
+    request.state       = state;
+    request.complete_ms = now;
+
+    if (state == QRCodeScanRequest::STATE_RESULT) {
+        _stats.results++;
+    } else {
+        _stats.no_reads++;
+    }
+
+    if (_on_complete) {
+        _on_complete(request, _on_complete_user_data);
+    }
+}
+
+bool QRCodeRequestTracker::_unlink(QRCodeScanRequest& request)
+{
+    QRCodeScanRequest* prev = nullptr;
+    for (QRCodeScanRequest* it = _head; it != nullptr; prev = it, it = it->_next) {
+        if (it != &request) {
+            continue;
+        }
+        if (prev) {
+            prev->_next = it->_next;
+        } else {
+            _head = it->_next;
+        }
+        if (_tail == it) {
+            _tail = prev;
+        }
+        request._next = nullptr;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,185 @@
+/*
+ * SPDX-FileCopyrightText: 2025 M5Stack Technology CO LTD
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include "M5ModuleQRCode.h"
+
+/**
+ * @brief Number of expired requests remembered to tag late results.
+ */
+#ifndef MODULE_QRCODE_REQUEST_LATE_HISTORY
+#define MODULE_QRCODE_REQUEST_LATE_HISTORY 8
+#endif
+
+/**
+ * @brief One trigger and its outcome. Storage is owned by the caller and must stay valid while the request is
+ * pending.
+ */
+struct QRCodeScanRequest {
+    enum State_t {
+        STATE_IDLE = 0,  // Not submitted
+        STATE_PENDING,   // Triggered, waiting for a result
+        STATE_RESULT,    // Completed with a scan result
+        STATE_NO_READ    // Completed without result before the deadline
+    };
+
+    // Optional result buffer, set before trigger(), always null terminated
+    char* result       = nullptr;
+    size_t result_size = 0;
+
+    // Filled by QRCodeRequestTracker
+    uint32_t id                 = 0;
+    State_t state               = STATE_IDLE;
+    uint32_t trigger_ms         = 0;  // Trigger pulse end, decoding starts here
+    uint32_t trigger_timeout_ms = 0;  // setTriggerTimeout() value applied for this trigger
+    uint32_t deadline_ms        = 0;  // Results after this time are tagged late
+    uint32_t complete_ms        = 0;
+    size_t result_len           = 0;  // Full result length, may exceed result_size - 1
+
+    inline bool isDone() const
+    {
+        return state == STATE_RESULT || state == STATE_NO_READ;
+    }
+
+    QRCodeScanRequest* _next = nullptr;
+};
+
+/**
+ * @brief Correlates triggers with scan results in pulse and key modes.
+ *
+ * trigger() pulses TRIG and queues the request. Results are attributed to the oldest pending request. Pending requests
+ * whose deadline (trigger time + trigger timeout + result margin) has passed complete as no-read. A result arriving
+ * within late_window_ms after such a deadline, while no request is pending or the oldest pending one was triggered less
+ * than min_decode_ms ago, is reported as late with the expired request id instead of being attributed to a newer
+ * request. Attach it with M5ModuleQRCode::setRequestTracker(), update() then feeds and expires it.
+ */
+class QRCodeRequestTracker {
+public:
+    struct Config_t {
+        uint32_t pulse_ms         = 25;    // TRIG low time, must be above 20 ms in pulse mode
+        uint32_t result_margin_ms = 100;   // Time for a result to reach the host after decoding stops
+        uint32_t late_window_ms   = 1000;  // Results up to this long after a deadline are tagged late
+        uint32_t min_decode_ms    = 30;    // Results sooner than this after a trigger belong to an older request
+    };
+
+    struct Stats_t {
+        uint32_t triggers    = 0;
+        uint32_t results     = 0;
+        uint32_t no_reads    = 0;
+        uint32_t late        = 0;
+        uint32_t unsolicited = 0;  // Results without any request
+    };
+
+    typedef void (*CompleteCallback_t)(QRCodeScanRequest& request, void* user_data);
+
+    /**
+     * @brief Late or unsolicited result.
+     * @param request_id Id of the expired request it most likely belongs to, 0 if unsolicited
+     */
+    typedef void (*LateCallback_t)(uint32_t request_id, const char* data, size_t len, void* user_data);
+
+    explicit QRCodeRequestTracker(M5ModuleQRCode& module) : _module(module)
+    {
+    }
+
+    Config_t getConfig() const
+    {
+        return _config;
+    }
+    void setConfig(const Config_t& config)
+    {
+        _config = config;
+    }
+
+    /**
+     * @brief Apply the trigger timeout if it changed, pulse TRIG and queue the request.
+     * Changing the trigger timeout is a blocking command that clears the rx buffer, so it is refused while other
+     * requests are pending. Keep it constant on fast lines, or wait for pending() to reach 0.
+     * @param request Caller owned request
+     * @param timeout_ms Trigger timeout in milliseconds, up to 65535
+     * @return false if the request is already pending, the timeout differs while other requests are pending, or
+     * writing the timeout failed
+     */
+    bool trigger(QRCodeScanRequest& request, uint32_t timeout_ms);
+
+    /**
+     * @brief Cancel a pending request, it does not consume a result.
+     * @param request Pending request
+     */
+    void cancel(QRCodeScanRequest& request);
+
+    /**
+     * @brief Report a scan result.
+     * @param data Scan result
+     * @param len Scan result length
+     */
+    void onScan(const char* data, size_t len);
+
+    /**
+     * @brief Complete expired requests as no-read.
+     */
+    void update();
+
+    /**
+     * @brief Get the number of pending requests.
+     * @return Pending count
+     */
+    size_t pending() const;
+
+    inline Stats_t getStats() const
+    {
+        return _stats;
+    }
+
+    /**
+     * @brief Set on request complete callback.
+     *
+     * @param callback
+     * @param user_data
+     */
+    inline void onComplete(CompleteCallback_t callback, void* user_data = nullptr)
+    {
+        _on_complete           = callback;
+        _on_complete_user_data = user_data;
+    }
+
+    /**
+     * @brief Set on late or unsolicited result callback.
+     *
+     * @param callback
+     * @param user_data
+     */
+    inline void onLateResult(LateCallback_t callback, void* user_data = nullptr)
+    {
+        _on_late           = callback;
+        _on_late_user_data = user_data;
+    }
+
+private:
+    struct Expired_t {
+        uint32_t id;
+        uint32_t deadline_ms;
+    };
+
+    M5ModuleQRCode& _module;
+    Config_t _config;
+    Stats_t _stats;
+
+    QRCodeScanRequest* _head = nullptr;
+    QRCodeScanRequest* _tail = nullptr;
+    uint32_t _next_id        = 1;
+
+    Expired_t _expired[MODULE_QRCODE_REQUEST_LATE_HISTORY];
+    size_t _expired_total = 0;
+
+    CompleteCallback_t _on_complete = nullptr;
+    void* _on_complete_user_data    = nullptr;
+    LateCallback_t _on_late         = nullptr;
+    void* _on_late_user_data        = nullptr;
+
+    bool _unlink(QRCodeScanRequest& request);
+    void _expire(uint32_t now);
+    void _complete(QRCodeScanRequest& request, QRCodeScanRequest::State_t state, uint32_t now);
+};
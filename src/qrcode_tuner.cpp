@@ -0,0 +1,266 @@
+/*
+ * SPDX-FileCopyrightText: 2025 M5Stack Technology CO LTD
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#include "qrcode_tuner.h"
+#include "debug.h"
+
+static uint32_t _fnv1a(const char* data, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (uint8_t)data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+void QRCodeAutoTuner::begin()
+{
+    for (int i = 0; i < REG_COUNT; i++) {
+        const Range_t& range = _config.ranges[i];
+        _apply((Register_t)i, max(range.min, min(range.max, range.initial)));
+    }
+
+    _window_start_ms = millis();
+    _scans           = 0;
+    _duplicates      = 0;
+    _uniques         = 0;
+    _min_gap_ms      = 0xFFFFFFFF;
+    _has_last        = false;
+    _has_changed     = false;
+    _has_pending     = false;
+    _evaluating      = false;
+    _decision_total  = 0;
+    _running         = true;
+}
+
+void QRCodeAutoTuner::onScan(const char* data, size_t len)
+{
+    if (!_running || !data || len == 0) {
+        return;
+    }
+
+    uint32_t now  = millis();
+    uint32_t hash = _fnv1a(data, len);
+
+    _scans++;
+    if (_has_last && hash == _last_hash) {
+        _duplicates++;
+        return;
+    }
+
+    _uniques++;
+    if (_has_last) {
+        _min_gap_ms = min(_min_gap_ms, now - _last_distinct_ms);
+    }
+    _last_hash        = hash;
+    _last_distinct_ms = now;
+    _has_last         = true;
+}
+
+bool QRCodeAutoTuner::update()
+{
+    if (!_running) {
+        return false;
+    }
+
+    uint32_t now = millis();
+    if (now - _window_start_ms < _config.window_ms) {
+        return _flush_pending();
+    }
+
+    Window_t window;
+    window.scans       = _scans;
+    window.duplicates  = _duplicates;
+    window.min_gap_ms  = _min_gap_ms;
+    window.unique_rate = _uniques * 1000.0f / (now - _window_start_ms);
+
+    _window_start_ms = now;
+    _scans           = 0;
+    _duplicates      = 0;
+    _uniques         = 0;
+    _min_gap_ms      = 0xFFFFFFFF;
+
+    // A revert is not rate limited
+    if (_evaluating && _evaluate(window)) {
+        return _flush_pending();
+    }
+
+    // Rate limit, one change at a time
+    if (_has_pending || (_has_changed && now - _last_change_ms < _config.min_change_interval_ms)) {
+        return _flush_pending();
+    }
+
+    _decide(window);
+    return _flush_pending();
+}
+
+bool QRCodeAutoTuner::_evaluate(const Window_t& window)
+{
+    _evaluating = false;
+
+    // No traffic after the change says nothing about it
+    if (window.scans == 0) {
+        return false;
+    }
+
+    float before = _evaluated.unique_rate;
+    if (window.unique_rate >= before * (1.0f - _config.revert_tolerance)) {
+        _LOG_DEBUG("tuner: reg %d change kept\n", _evaluated.reg);
+        return false;
+    }
+
+    if (!_change(_evaluated.reg, _evaluated.old_value, REASON_REVERT, window)) {
+        return false;
+    }
+    _hold_until_ms[_evaluated.reg] = millis() + _config.revert_hold_ms;
+    return true;
+}
+
+bool QRCodeAutoTuner::_decide(const Window_t& window)
+{
+    float dup_ratio = window.scans > 0 ? (float)window.duplicates / window.scans : 0.0f;
+    uint32_t gap    = window.min_gap_ms;
+    bool has_gap    = gap != 0xFFFFFFFF;
+
+    if (dup_ratio > _config.target_dup_ratio) {
+        return _change(REG_SAME_CODE_INTERVAL, _values[REG_SAME_CODE_INTERVAL] * 3 / 2 + 1, REASON_DUP_HIGH, window);
+    }
+    if (has_gap && _values[REG_DIFF_CODE_INTERVAL] * 2u > gap &&
+        _change(REG_DIFF_CODE_INTERVAL, gap / 2, REASON_GAP_SHORT, window)) {
+        return true;
+    }
+    if (has_gap && _values[REG_CONTINUOUS_DECODE_DELAY] * 2u > gap &&
+        _change(REG_CONTINUOUS_DECODE_DELAY, gap / 2, REASON_GAP_SHORT, window)) {
+        return true;
+    }
+    if (has_gap && _values[REG_DECODE_DELAY] * 2u > gap &&
+        _change(REG_DECODE_DELAY, gap / 2, REASON_GAP_SHORT, window)) {
+        return true;
+    }
+    // Slows the line down until the gap rule undoes it, so only when power matters more than throughput
+    if (window.scans == 0 && _config.idle_backoff) {
+        return _change(REG_CONTINUOUS_DECODE_DELAY, _values[REG_CONTINUOUS_DECODE_DELAY] * 3 / 2 + 10, REASON_IDLE,
+                       window) ||
+               _change(REG_DECODE_DELAY, _values[REG_DECODE_DELAY] * 3 / 2 + 10, REASON_IDLE, window);
+    }
+
+    return false;
+}
+
+bool QRCodeAutoTuner::_change(Register_t reg, uint32_t value, Reason_t reason, const Window_t& window)
+{
+    const Range_t& range = _config.ranges[reg];
+    uint16_t new_value   = max((uint32_t)range.min, min((uint32_t)range.max, value));
+    uint16_t old_value   = _values[reg];
+    if (new_value == old_value) {
+        return false;
+    }
+    if (reason != REASON_REVERT && (int32_t)(millis() - _hold_until_ms[reg]) < 0) {
+        return false;
+    }
+
+    _pending.reg         = reg;
+    _pending.reason      = reason;
+    _pending.old_value   = old_value;
+    _pending.new_value   = new_value;
+    _pending.scans       = window.scans;
+    _pending.duplicates  = window.duplicates;
+    _pending.min_gap_ms  = window.min_gap_ms;
+    _pending.unique_rate = window.unique_rate;
+    _has_pending         = true;
+
+    return true;
+}
+
+bool QRCodeAutoTuner::_flush_pending()
+{
+    // Writing flushes the rx buffer, wait until every received scan has been read
+    if (!_has_pending || _device.available() > 0) {
+        return false;
+    }
+
+    uint32_t now = millis();
+    _apply(_pending.reg, _pending.new_value);
+    _last_change_ms = now;
+    _has_changed    = true;
+    _has_pending    = false;
+
+    Decision_t& decision = _history[_decision_total % MODULE_QRCODE_TUNER_HISTORY_SIZE];
+    decision             = _pending;
+    decision.time_ms     = now;
+    _decision_total++;
+
+    // Measure the effect of throughput changes on a window that starts with the new value
+    _evaluating = decision.reason == REASON_GAP_SHORT;
+    _evaluated  = decision;
+
+    _window_start_ms = now;
+    _scans           = 0;
+    _duplicates      = 0;
+    _uniques         = 0;
+    _min_gap_ms      = 0xFFFFFFFF;
+
+    _LOG_DEBUG("tuner: reg %d %d -> %d, reason %d\n", decision.reg, decision.old_value, decision.new_value,
+               decision.reason);
+
+    if (_on_decision) {
+        _on_decision(decision, _on_decision_user_data);
+    }
+
+    return true;
+}
+
+void QRCodeAutoTuner::_apply(Register_t reg, uint16_t value)
+{
+    static constexpr QRCodeM14::Register_t device_reg[] = {
+        QRCodeM14::REG_SAME_CODE_INTERVAL,
+        QRCodeM14::REG_DIFF_CODE_INTERVAL,
+        QRCodeM14::REG_CONTINUOUS_DECODE_DELAY,
+        QRCodeM14::REG_DECODE_DELAY,
+    };
+
+    if (reg < 0 || reg >= REG_COUNT) {
+        return;
+    }
+    _values[reg] = value;
+
+    // Live adjustment, the configured value stays in the config snapshot
+    _device._set_register(device_reg[reg], value, false);
+}
+
+const QRCodeAutoTuner::Decision_t& QRCodeAutoTuner::getDecision(size_t index) const
+{
+    static const Decision_t empty = {};
+
+    size_t count = getDecisionCount();
+    if (count == 0) {
+        return empty;
+    }
+    if (index >= count) {
+        index = count - 1;
+    }
+    return _history[(_decision_total - 1 - index) % MODULE_QRCODE_TUNER_HISTORY_SIZE];
+}
+
+const char* QRCodeAutoTuner::registerToCStr(Register_t reg)
+{
+    static constexpr const char* reg_str[] = {"same code interval", "diff code interval", "continuous decode delay",
+                                              "decode delay"};
+
+    if (reg < 0 || reg >= REG_COUNT) {
+        return "unknown register";
+    }
+    return reg_str[reg];
+}
+
+const char* QRCodeAutoTuner::reasonToCStr(Reason_t reason)
+{
+    static constexpr const char* reason_str[] = {"duplicate ratio high", "code gap short", "idle", "revert"};
+
+    if (reason < 0 || reason > REASON_REVERT) {
+        return "unknown reason";
+    }
+    return reason_str[reason];
+}
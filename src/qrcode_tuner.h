@@ -0,0 +1,230 @@
+/*
+ * SPDX-FileCopyrightText: 2025 M5Stack Technology CO LTD
+ *
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+#include "qrcode_m14.h"
+
+/**
+ * @brief Number of tuning decisions kept for auditing.
+ */
+#ifndef MODULE_QRCODE_TUNER_HISTORY_SIZE
+#define MODULE_QRCODE_TUNER_HISTORY_SIZE 16
+#endif
+
+/**
+ * @brief Opt-in controller that adjusts the decode interval registers from observed scan throughput.
+ *
+ * The goal is the highest rate of distinct codes while duplicates stay under target_dup_ratio. Scans are observed over
+ * a window. At the end of each window at most one register is changed, and never more often than
+ * min_change_interval_ms. Rules, first match wins:
+ *  - duplicate ratio above target: raise same code interval (it only suppresses repeats, distinct codes are unaffected)
+ *  - distinct codes arrive closer than twice the diff code interval: lower diff code interval
+ *  - distinct codes arrive closer than twice the decode delays: lower continuous decode delay, then decode delay
+ *  - idle window, only with idle_backoff: raise continuous decode delay, then decode delay
+ * A change made for throughput is checked on the first full window after it: if the distinct code rate dropped by
+ * more than revert_tolerance, the old value is restored and the register is left alone for revert_hold_ms.
+ *
+ * A register write is a blocking command that clears the rx buffer. A decided change is therefore kept pending until
+ * update() finds no rx data, i.e. after M5ModuleQRCode::update() has passed every received scan on.
+ */
+class QRCodeAutoTuner {
+public:
+    enum Register_t {
+        REG_SAME_CODE_INTERVAL = 0,
+        REG_DIFF_CODE_INTERVAL,
+        REG_CONTINUOUS_DECODE_DELAY,
+        REG_DECODE_DELAY,
+        REG_COUNT
+    };
+
+    enum Reason_t {
+        REASON_DUP_HIGH = 0,  // Duplicate ratio above target
+        REASON_GAP_SHORT,     // Distinct codes arrive faster than the register allows
+        REASON_IDLE,          // No scan during the window, see Config_t::idle_backoff
+        REASON_REVERT         // The previous change lowered the distinct code rate
+    };
+
+    /**
+     * @brief Register bounds, values in milliseconds.
+     */
+    struct Range_t {
+        uint16_t min;
+        uint16_t max;
+        uint16_t initial;
+    };
+
+    struct Config_t {
+        uint32_t window_ms              = 5000;   // Observation window
+        uint32_t min_change_interval_ms = 15000;  // Min time between two register changes
+        float target_dup_ratio          = 0.05f;  // Max duplicates / scans
+        bool idle_backoff               = false;  // Raise decode delays in idle windows to save power
+        float revert_tolerance          = 0.1f;   // Revert a change if distinct codes/s drop by more than this
+        uint32_t revert_hold_ms         = 60000;  // Leave a reverted register alone for this long
+        Range_t ranges[REG_COUNT]       = {
+            {100, 5000, 1000},  // REG_SAME_CODE_INTERVAL
+            {0, 1000, 200},     // REG_DIFF_CODE_INTERVAL
+            {0, 2000, 100},     // REG_CONTINUOUS_DECODE_DELAY
+            {0, 2000, 0},       // REG_DECODE_DELAY
+        };
+    };
+
+    /**
+     * @brief Audit record of one register change and the statistics it was based on.
+     */
+    struct Decision_t {
+        uint32_t time_ms;
+        Register_t reg;
+        Reason_t reason;
+        uint16_t old_value;
+        uint16_t new_value;
+        uint32_t scans;       // Scans during the window
+        uint32_t duplicates;  // Duplicated scans during the window
+        uint32_t min_gap_ms;  // Min time between distinct codes, 0xFFFFFFFF if less than 2 distinct codes
+        float unique_rate;    // Distinct codes per second, for REASON_REVERT in the window after the change
+    };
+
+    typedef void (*DecisionCallback_t)(const Decision_t& decision, void* user_data);
+
+    explicit QRCodeAutoTuner(QRCodeM14& device) : _device(device)
+    {
+    }
+
+    Config_t getConfig() const
+    {
+        return _config;
+    }
+    void setConfig(const Config_t& config)
+    {
+        _config = config;
+    }
+
+    /**
+     * @brief Apply the initial register values and start observing.
+     */
+    void begin();
+
+    /**
+     * @brief Stop adjusting registers, current values are kept and a pending change is dropped.
+     */
+    inline void end()
+    {
+        _running     = false;
+        _has_pending = false;
+    }
+
+    /**
+     * @brief Report a scan result.
+     * @param data Scan result
+     * @param len Scan result length
+     */
+    void onScan(const char* data, size_t len);
+
+    /**
+     * @brief Close the observation window when due and decide at most one register change, then write a pending
+     * change if no rx data is waiting.
+     * @return true if a register was changed
+     */
+    bool update();
+
+    /**
+     * @brief Get current register value.
+     * @param reg Register
+     * @return Value in milliseconds
+     */
+    inline uint16_t getValue(Register_t reg) const
+    {
+        return _values[reg];
+    }
+
+    /**
+     * @brief Get number of decisions kept in history.
+     * @return Decision count, at most MODULE_QRCODE_TUNER_HISTORY_SIZE
+     */
+    inline size_t getDecisionCount() const
+    {
+        return _decision_total < MODULE_QRCODE_TUNER_HISTORY_SIZE ? _decision_total : MODULE_QRCODE_TUNER_HISTORY_SIZE;
+    }
+
+    /**
+     * @brief Get decision from history.
+     * @param index 0 is the most recent decision
+     * @return Decision, all zero if the history is empty
+     */
+    const Decision_t& getDecision(size_t index) const;
+
+    /**
+     * @brief Set on decision callback.
+     *
+     * @param callback
+     * @param user_data
+     */
+    inline void onDecision(DecisionCallback_t callback, void* user_data = nullptr)
+    {
+        _on_decision           = callback;
+        _on_decision_user_data = user_data;
+    }
+
+    /**
+     * @brief Convert register to string.
+     * @param reg Register
+     * @return Register name (static storage)
+     */
+    static const char* registerToCStr(Register_t reg);
+
+    /**
+     * @brief Convert reason to string.
+     * @param reason Reason
+     * @return Reason description (static storage)
+     */
+    static const char* reasonToCStr(Reason_t reason);
+
+private:
+    QRCodeM14& _device;
+    Config_t _config;
+    bool _running = false;
+    uint16_t _values[REG_COUNT];
+
+    // Current window
+    uint32_t _window_start_ms  = 0;
+    uint32_t _scans            = 0;
+    uint32_t _duplicates       = 0;
+    uint32_t _uniques          = 0;
+    uint32_t _min_gap_ms       = 0xFFFFFFFF;
+    uint32_t _last_hash        = 0;
+    uint32_t _last_distinct_ms = 0;
+    bool _has_last             = false;
+
+    uint32_t _last_change_ms = 0;
+    bool _has_changed        = false;
+
+    // Decided change waiting for an idle rx line
+    Decision_t _pending;
+    bool _has_pending = false;
+
+    // Applied change whose effect on the distinct code rate is measured in the next window
+    Decision_t _evaluated;
+    bool _evaluating = false;
+
+    uint32_t _hold_until_ms[REG_COUNT] = {};
+
+    Decision_t _history[MODULE_QRCODE_TUNER_HISTORY_SIZE];
+    size_t _decision_total = 0;
+
+    DecisionCallback_t _on_decision = nullptr;
+    void* _on_decision_user_data    = nullptr;
+
+    struct Window_t {
+        uint32_t scans;
+        uint32_t duplicates;
+        uint32_t min_gap_ms;
+        float unique_rate;
+    };
+
+    void _apply(Register_t reg, uint16_t value);
+    bool _decide(const Window_t& window);
+    bool _evaluate(const Window_t& window);
+    bool _change(Register_t reg, uint32_t value, Reason_t reason, const Window_t& window);
+    bool _flush_pending();
+};